@@ -0,0 +1,487 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * Copyright © 2016 Ingo Bürk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the names of the authors or their
+ * institutions shall not be used in advertising or otherwise to promote the
+ * sale, use or other dealings in this Software without prior written
+ * authorization from the authors.
+ *
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xresource.h>
+
+#include "xcb_xrm.h"
+
+/*
+ * Benchmarks the library against Xlib's resource manager on synthetic
+ * databases. For every database size given on the command line (default:
+ * 1000, 10000 and 100000 entries), it reports the time per operation and,
+ * with glibc, the number of heap allocations per operation.
+ *
+ */
+
+/* The number of different names used for components. */
+#define NUM_NAMES 64
+/* The maximum number of components of generated entries and queries. */
+#define MAX_DEPTH 6
+/* The number of queries run against every database. */
+#define NUM_QUERIES 10000
+/* Every operation is repeated until it ran for at least this long. */
+#define MIN_DURATION 0.2
+
+typedef struct bench_result_t {
+    /* Seconds per operation. */
+    double seconds;
+    /* Heap allocations per operation. */
+    double allocations;
+} bench_result_t;
+
+typedef struct bench_input_t {
+    int num_entries;
+    /* The generated database and its two halves. */
+    char *str;
+    char *first_half;
+    char *second_half;
+    /* The generated database, stored in a file. */
+    char filename[64];
+    /* Fully qualified resource names and classes to query. */
+    char *names[NUM_QUERIES];
+    char *classes[NUM_QUERIES];
+} bench_input_t;
+
+static unsigned long allocations;
+static uint64_t random_state = 1;
+
+/* Generators */
+static int bench_random(int n);
+static char *bench_generate_database(int num_entries);
+static void bench_generate_query(char **name, char **class);
+static int bench_input_init(bench_input_t *input, int num_entries);
+static void bench_input_free(bench_input_t *input);
+
+/* Measurements */
+static double bench_now(void);
+static void bench_report(const char *operation, int num_entries, bench_result_t xcb, bench_result_t xlib);
+
+/* Operations */
+static bench_result_t bench_xcb_from_string(bench_input_t *input);
+static bench_result_t bench_xlib_from_string(bench_input_t *input);
+static bench_result_t bench_xcb_from_file(bench_input_t *input);
+static bench_result_t bench_xlib_from_file(bench_input_t *input);
+static bench_result_t bench_xcb_combine(bench_input_t *input);
+static bench_result_t bench_xlib_combine(bench_input_t *input);
+static bench_result_t bench_xcb_to_string(bench_input_t *input);
+static bench_result_t bench_xlib_to_string(bench_input_t *input);
+static bench_result_t bench_xcb_get_resource(bench_input_t *input);
+static bench_result_t bench_xlib_get_resource(bench_input_t *input);
+
+typedef struct bench_operation_t {
+    const char *name;
+    bench_result_t (*xcb)(bench_input_t *input);
+    bench_result_t (*xlib)(bench_input_t *input);
+} bench_operation_t;
+
+static const bench_operation_t operations[] = {
+    { "from_string", bench_xcb_from_string, bench_xlib_from_string },
+    { "from_file", bench_xcb_from_file, bench_xlib_from_file },
+    { "combine", bench_xcb_combine, bench_xlib_combine },
+    { "to_string", bench_xcb_to_string, bench_xlib_to_string },
+    { "get_resource", bench_xcb_get_resource, bench_xlib_get_resource },
+};
+
+#ifdef __GLIBC__
+/* Count all heap allocations, including those of both libraries, by
+ * interposing the allocator. */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) {
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+#define HAVE_ALLOCATION_COUNTS 1
+#else
+#define HAVE_ALLOCATION_COUNTS 0
+#endif
+
+/* Runs body until MIN_DURATION has passed, timing only the part between
+ * BENCH_START and BENCH_STOP, and stores the averages per op operations in
+ * result. */
+#define BENCH_LOOP(result, ops, body)                                          \
+    do {                                                                       \
+        double __elapsed = 0;                                                  \
+        unsigned long __allocations = 0;                                       \
+        long __runs = 0;                                                       \
+        double __start;                                                        \
+        unsigned long __start_allocations;                                     \
+        while (__elapsed < MIN_DURATION) {                                     \
+            body;                                                              \
+            __runs++;                                                          \
+        }                                                                      \
+        (result).seconds = __elapsed / (__runs * (double)(ops));               \
+        (result).allocations = __allocations / (__runs * (double)(ops));       \
+    } while (0)
+
+#define BENCH_START                                                            \
+    do {                                                                       \
+        __start_allocations = allocations;                                     \
+        __start = bench_now();                                                 \
+    } while (0)
+
+#define BENCH_STOP                                                             \
+    do {                                                                       \
+        __elapsed += bench_now() - __start;                                    \
+        __allocations += allocations - __start_allocations;                    \
+    } while (0)
+
+int main(int argc, char *argv[]) {
+    int default_sizes[] = { 1000, 10000, 100000 };
+    int num_sizes = argc > 1 ? argc - 1 : (int)(sizeof(default_sizes) / sizeof(int));
+
+    XrmInitialize();
+
+    printf("%-14s %9s %14s %14s %9s %12s %12s\n",
+            "operation", "entries", "xcb-xrm [us]", "Xlib [us]", "ratio", "xcb allocs", "Xlib allocs");
+
+    for (int i = 0; i < num_sizes; i++) {
+        bench_input_t input;
+        int num_entries = argc > 1 ? atoi(argv[i + 1]) : default_sizes[i];
+
+        if (num_entries <= 0) {
+            fprintf(stderr, "Invalid number of entries: %s\n", argv[i + 1]);
+            return EXIT_FAILURE;
+        }
+
+        if (bench_input_init(&input, num_entries) < 0) {
+            fprintf(stderr, "Failed to generate the input\n");
+            return EXIT_FAILURE;
+        }
+
+        for (size_t j = 0; j < sizeof(operations) / sizeof(bench_operation_t); j++) {
+            bench_result_t xcb = operations[j].xcb(&input);
+            bench_result_t xlib = operations[j].xlib(&input);
+            bench_report(operations[j].name, num_entries, xcb, xlib);
+        }
+
+        bench_input_free(&input);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int bench_random(int n) {
+    random_state = random_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (random_state >> 33) % n;
+}
+
+/* Generates a database with entries of one to MAX_DEPTH components. About a
+ * third of the bindings are loose and some components are wildcards. */
+static char *bench_generate_database(int num_entries) {
+    char *str = NULL;
+    size_t size = 0;
+    FILE *stream = open_memstream(&str, &size);
+    if (stream == NULL)
+        return NULL;
+
+    for (int i = 0; i < num_entries; i++) {
+        int depth = 1 + bench_random(MAX_DEPTH);
+
+        for (int j = 0; j < depth; j++) {
+            int binding = bench_random(3);
+
+            if (binding == 0)
+                fputc('*', stream);
+            else if (j > 0)
+                fputc('.', stream);
+
+            /* The last component must not be a wildcard. */
+            if (j < depth - 1 && bench_random(10) == 0)
+                fputc('?', stream);
+            else
+                fprintf(stream, "%c%d", bench_random(4) == 0 ? 'N' : 'n', bench_random(NUM_NAMES));
+        }
+
+        fprintf(stream, ": value %d\n", i);
+    }
+
+    fclose(stream);
+    return str;
+}
+
+/* Generates a fully qualified query of two to MAX_DEPTH components. Classes
+ * use the capitalized names, which some entries use, too. */
+static void bench_generate_query(char **name, char **class) {
+    char name_buffer[8 * MAX_DEPTH] = "";
+    char class_buffer[8 * MAX_DEPTH] = "";
+    int depth = 2 + bench_random(MAX_DEPTH - 1);
+
+    for (int j = 0; j < depth; j++) {
+        int component = bench_random(NUM_NAMES);
+        char *name_end = name_buffer + strlen(name_buffer);
+        char *class_end = class_buffer + strlen(class_buffer);
+
+        sprintf(name_end, "%sn%d", j == 0 ? "" : ".", component);
+        sprintf(class_end, "%sN%d", j == 0 ? "" : ".", component);
+    }
+
+    *name = strdup(name_buffer);
+    *class = strdup(class_buffer);
+}
+
+static int bench_input_init(bench_input_t *input, int num_entries) {
+    char *middle;
+    FILE *file;
+    int fd;
+
+    memset(input, 0, sizeof(bench_input_t));
+    input->num_entries = num_entries;
+
+    input->str = bench_generate_database(num_entries);
+    if (input->str == NULL)
+        return -1;
+
+    /* Split the database at the line in its middle. */
+    middle = strchr(input->str + strlen(input->str) / 2, '\n');
+    input->first_half = strndup(input->str, middle + 1 - input->str);
+    input->second_half = strdup(middle + 1);
+
+    strcpy(input->filename, "/tmp/xcb-util-xrm-bench-XXXXXX");
+    if ((fd = mkstemp(input->filename)) < 0 || (file = fdopen(fd, "w")) == NULL)
+        return -1;
+    fputs(input->str, file);
+    fclose(file);
+
+    for (int i = 0; i < NUM_QUERIES; i++)
+        bench_generate_query(&(input->names[i]), &(input->classes[i]));
+
+    return 0;
+}
+
+static void bench_input_free(bench_input_t *input) {
+    unlink(input->filename);
+    free(input->str);
+    free(input->first_half);
+    free(input->second_half);
+    for (int i = 0; i < NUM_QUERIES; i++) {
+        free(input->names[i]);
+        free(input->classes[i]);
+    }
+}
+
+static double bench_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void bench_report(const char *operation, int num_entries, bench_result_t xcb, bench_result_t xlib) {
+    printf("%-14s %9d %14.3f %14.3f %9.2f", operation, num_entries, xcb.seconds * 1e6, xlib.seconds * 1e6,
+            xcb.seconds / xlib.seconds);
+    if (HAVE_ALLOCATION_COUNTS)
+        printf(" %12.1f %12.1f\n", xcb.allocations, xlib.allocations);
+    else
+        printf(" %12s %12s\n", "-", "-");
+}
+
+static bench_result_t bench_xcb_from_string(bench_input_t *input) {
+    bench_result_t result;
+
+    BENCH_LOOP(result, 1, {
+        xcb_xrm_database_t *database;
+
+        BENCH_START;
+        database = xcb_xrm_database_from_string(input->str);
+        BENCH_STOP;
+
+        xcb_xrm_database_free(database);
+    });
+
+    return result;
+}
+
+static bench_result_t bench_xlib_from_string(bench_input_t *input) {
+    bench_result_t result;
+
+    BENCH_LOOP(result, 1, {
+        XrmDatabase database;
+
+        BENCH_START;
+        database = XrmGetStringDatabase(input->str);
+        BENCH_STOP;
+
+        XrmDestroyDatabase(database);
+    });
+
+    return result;
+}
+
+static bench_result_t bench_xcb_from_file(bench_input_t *input) {
+    bench_result_t result;
+
+    BENCH_LOOP(result, 1, {
+        xcb_xrm_database_t *database;
+
+        BENCH_START;
+        database = xcb_xrm_database_from_file(input->filename);
+        BENCH_STOP;
+
+        xcb_xrm_database_free(database);
+    });
+
+    return result;
+}
+
+static bench_result_t bench_xlib_from_file(bench_input_t *input) {
+    bench_result_t result;
+
+    BENCH_LOOP(result, 1, {
+        XrmDatabase database;
+
+        BENCH_START;
+        database = XrmGetFileDatabase(input->filename);
+        BENCH_STOP;
+
+        XrmDestroyDatabase(database);
+    });
+
+    return result;
+}
+
+static bench_result_t bench_xcb_combine(bench_input_t *input) {
+    bench_result_t result;
+
+    BENCH_LOOP(result, 1, {
+        xcb_xrm_database_t *source = xcb_xrm_database_from_string(input->second_half);
+        xcb_xrm_database_t *target = xcb_xrm_database_from_string(input->first_half);
+
+        BENCH_START;
+        xcb_xrm_database_combine(source, &target, true);
+        BENCH_STOP;
+
+        xcb_xrm_database_free(target);
+    });
+
+    return result;
+}
+
+static bench_result_t bench_xlib_combine(bench_input_t *input) {
+    bench_result_t result;
+
+    BENCH_LOOP(result, 1, {
+        XrmDatabase source = XrmGetStringDatabase(input->second_half);
+        XrmDatabase target = XrmGetStringDatabase(input->first_half);
+
+        BENCH_START;
+        XrmCombineDatabase(source, &target, True);
+        BENCH_STOP;
+
+        XrmDestroyDatabase(target);
+    });
+
+    return result;
+}
+
+static bench_result_t bench_xcb_to_string(bench_input_t *input) {
+    xcb_xrm_database_t *database = xcb_xrm_database_from_string(input->str);
+    bench_result_t result;
+
+    BENCH_LOOP(result, 1, {
+        char *str;
+
+        BENCH_START;
+        str = xcb_xrm_database_to_string(database);
+        BENCH_STOP;
+
+        free(str);
+    });
+
+    xcb_xrm_database_free(database);
+    return result;
+}
+
+static bench_result_t bench_xlib_to_string(bench_input_t *input) {
+    XrmDatabase database = XrmGetStringDatabase(input->str);
+    bench_result_t result;
+
+    /* Xlib can only write databases to files. */
+    BENCH_LOOP(result, 1, {
+        BENCH_START;
+        XrmPutFileDatabase(database, "/dev/null");
+        BENCH_STOP;
+    });
+
+    XrmDestroyDatabase(database);
+    return result;
+}
+
+static bench_result_t bench_xcb_get_resource(bench_input_t *input) {
+    xcb_xrm_database_t *database = xcb_xrm_database_from_string(input->str);
+    bench_result_t result;
+
+    BENCH_LOOP(result, NUM_QUERIES, {
+        BENCH_START;
+        /* Xlib does not copy the value either. */
+        for (int i = 0; i < NUM_QUERIES; i++)
+            (void)xcb_xrm_resource_get_string_borrowed(database, input->names[i], input->classes[i]);
+        BENCH_STOP;
+    });
+
+    xcb_xrm_database_free(database);
+    return result;
+}
+
+static bench_result_t bench_xlib_get_resource(bench_input_t *input) {
+    XrmDatabase database = XrmGetStringDatabase(input->str);
+    bench_result_t result;
+
+    BENCH_LOOP(result, NUM_QUERIES, {
+        BENCH_START;
+        for (int i = 0; i < NUM_QUERIES; i++) {
+            char *type;
+            XrmValue value;
+            XrmGetResource(database, input->names[i], input->classes[i], &type, &value);
+        }
+        BENCH_STOP;
+    });
+
+    XrmDestroyDatabase(database);
+    return result;
+}
@@ -0,0 +1,90 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * Copyright © 2016 Ingo Bürk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the names of the authors or their
+ * institutions shall not be used in advertising or otherwise to promote the
+ * sale, use or other dealings in this Software without prior written
+ * authorization from the authors.
+ *
+ */
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include "externals.h"
+
+/** A chunk of memory from which allocations are carved. */
+typedef struct xcb_xrm_arena_chunk_t {
+    /* The next (older) chunk. */
+    struct xcb_xrm_arena_chunk_t *next;
+    /* The number of usable bytes in data. */
+    size_t size;
+    /* The number of bytes already handed out. */
+    size_t used;
+    /* The memory handed out by the arena. It directly follows the chunk. */
+    char *data;
+} xcb_xrm_arena_chunk_t;
+
+/**
+ * A bump allocator. Memory allocated from an arena cannot be freed
+ * individually; instead, all of it is released at once when the arena is
+ * freed. Allocations are zero-initialized.
+ *
+ */
+typedef struct xcb_xrm_arena_t {
+    /* The chunk allocations are currently carved from. Older chunks are
+     * linked from it. */
+    xcb_xrm_arena_chunk_t *chunks;
+    /* The total number of bytes allocated for chunks. */
+    size_t total_size;
+} xcb_xrm_arena_t;
+
+/**
+ * Allocates size bytes of zero-initialized memory from the arena.
+ *
+ * @return The allocated memory or NULL if memory could not be allocated.
+ *
+ */
+void *xcb_xrm_arena_alloc(xcb_xrm_arena_t *arena, size_t size);
+
+/**
+ * Shrinks the most recent allocation of the arena to new_size bytes, giving
+ * the remaining bytes back to the arena. Nothing happens if ptr was not the
+ * most recent allocation.
+ *
+ */
+void xcb_xrm_arena_shrink(xcb_xrm_arena_t *arena, void *ptr, size_t size, size_t new_size);
+
+/**
+ * Moves all memory of the source arena into the target arena. The source
+ * arena is empty afterwards, but memory allocated from it stays valid until
+ * the target arena is freed.
+ *
+ */
+void xcb_xrm_arena_splice(xcb_xrm_arena_t *target, xcb_xrm_arena_t *source);
+
+/**
+ * Frees all memory allocated from the arena.
+ *
+ */
+void xcb_xrm_arena_free(xcb_xrm_arena_t *arena);
+
+#endif /* __ARENA_H__ */
@@ -0,0 +1,105 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * Copyright © 2016 Ingo Bürk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the names of the authors or their
+ * institutions shall not be used in advertising or otherwise to promote the
+ * sale, use or other dealings in this Software without prior written
+ * authorization from the authors.
+ *
+ */
+#ifndef __BLOB_H__
+#define __BLOB_H__
+
+#include "externals.h"
+
+#include "database.h"
+
+/* Identifies a serialized database ("XRMB"). Since all fields are stored in
+ * the byte order of the machine which created the blob, a blob from a machine
+ * with a different byte order does not match it. */
+#define BLOB_MAGIC 0x424d5258
+#define BLOB_VERSION 1
+
+/* The name of wildcard components. */
+#define BLOB_NONE UINT32_MAX
+
+/**
+ * The header of a serialized database. All offsets are relative to the start
+ * of the blob, so it can be loaded from any address. The header is followed by
+ * the component table, the entry table and the string pool, in this order.
+ *
+ */
+typedef struct xcb_xrm_blob_header_t {
+    uint32_t magic;
+    uint32_t version;
+
+    /* The table of all components of all entries. */
+    uint32_t components;
+    uint32_t num_components;
+
+    /* The table of entries in the order they were inserted. */
+    uint32_t entries;
+    uint32_t num_entries;
+
+    /* The NUL-terminated component names and values. Every name is stored
+     * only once. */
+    uint32_t strings;
+    uint32_t strings_size;
+} xcb_xrm_blob_header_t;
+
+/** A component in the component table. */
+typedef struct xcb_xrm_blob_component_t {
+    /* The offset of the name in the string pool or BLOB_NONE for a wildcard
+     * component. */
+    uint32_t name;
+    /* One of xcb_xrm_binding_type_t. */
+    uint32_t binding_type;
+} xcb_xrm_blob_component_t;
+
+/** An entry in the entry table. */
+typedef struct xcb_xrm_blob_entry_t {
+    /* The offset of the value in the string pool. */
+    uint32_t value;
+    /* The range of the entry's components in the component table. */
+    uint32_t first_component;
+    uint32_t num_components;
+} xcb_xrm_blob_entry_t;
+
+/**
+ * Serializes the entries of the database. The blob is allocated dynamically
+ * and must be free'd.
+ *
+ * @return 0 on success, a negative error code otherwise.
+ *
+ */
+int xcb_xrm_blob_write(xcb_xrm_database_t *database, void **blob, size_t *length);
+
+/**
+ * Inserts the entries of a serialized database into the database, which
+ * must be empty.
+ *
+ * @return 0 on success, a negative error code if the blob is not valid.
+ *
+ */
+int xcb_xrm_blob_read(xcb_xrm_database_t *database, const void *blob, size_t length);
+
+#endif /* __BLOB_H__ */
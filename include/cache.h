@@ -0,0 +1,102 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * Copyright © 2016 Ingo Bürk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the names of the authors or their
+ * institutions shall not be used in advertising or otherwise to promote the
+ * sale, use or other dealings in this Software without prior written
+ * authorization from the authors.
+ *
+ */
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include "externals.h"
+
+#include "entry.h"
+
+/** A single cached query result. */
+typedef struct xcb_xrm_cache_slot_t {
+    /* The name query, followed by a '\0' and the class query. */
+    char *key;
+    size_t name_len;
+    size_t class_len;
+    uint32_t hash;
+    /* The database generation this result is valid for. */
+    unsigned long generation;
+    /* The matched entry or NULL if the query did not match. */
+    xcb_xrm_entry_t *entry;
+} xcb_xrm_cache_slot_t;
+
+/**
+ * A bounded cache of query results. Every query maps to exactly one slot,
+ * which is overwritten by the next query mapping to it.
+ *
+ * Results carry the generation of the database they were computed for, so
+ * the whole cache is invalidated by advancing the generation.
+ *
+ */
+typedef struct xcb_xrm_cache_t {
+    /* The slots or NULL if the cache is disabled. */
+    xcb_xrm_cache_slot_t *slots;
+    /* The number of slots. This is zero or a power of two. */
+    size_t size;
+
+    unsigned long hits;
+    unsigned long misses;
+} xcb_xrm_cache_t;
+
+/**
+ * Changes the number of slots of the cache, dropping all cached results.
+ * The size is rounded up to a power of two. A size of zero disables the
+ * cache.
+ *
+ * @return 0 on success, a negative error code otherwise. On error, the cache
+ * is disabled.
+ *
+ */
+int xcb_xrm_cache_resize(xcb_xrm_cache_t *cache, size_t size);
+
+/**
+ * Looks up the result of the given query. Both res_name and res_class must
+ * not be NULL.
+ *
+ * @return true if the result is cached, in which case it is stored in entry.
+ *
+ */
+bool xcb_xrm_cache_lookup(xcb_xrm_cache_t *cache, unsigned long generation,
+        const char *res_name, const char *res_class, xcb_xrm_entry_t **entry);
+
+/**
+ * Stores the result of the given query. Both res_name and res_class must not
+ * be NULL. entry may be NULL to remember that the query did not match.
+ *
+ */
+void xcb_xrm_cache_store(xcb_xrm_cache_t *cache, unsigned long generation,
+        const char *res_name, const char *res_class, xcb_xrm_entry_t *entry);
+
+/**
+ * Frees all memory used by the cache and disables it.
+ *
+ */
+void xcb_xrm_cache_free(xcb_xrm_cache_t *cache);
+
+#endif /* __CACHE_H__ */
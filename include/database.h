@@ -31,9 +31,134 @@
 
 #include "externals.h"
 
+#include <pthread.h>
+
 #include "xcb_xrm.h"
+#include "arena.h"
+#include "cache.h"
 #include "entry.h"
+#include "frozen.h"
+#include "lazy.h"
+#include "node.h"
+
+struct xcb_xrm_database_t {
+    /* All entries of this database in the order they were inserted. */
+    TAILQ_HEAD(entries_head, xcb_xrm_entry_t) entries;
+
+    /* Index over the entries which is used to match queries. */
+    xcb_xrm_node_t *root;
+
+    /* Read-only copy of the index which is used instead if the database has
+     * been frozen. It is discarded whenever the database is modified. */
+    xcb_xrm_frozen_t *frozen;
+
+    /* The number of entries. */
+    size_t num_entries;
+
+    /* The position which will be assigned to the next inserted entry. */
+    unsigned long next_position;
+
+    /* All entries, their components and values are allocated from this
+     * arena. Entries which are removed from the database stay in the arena
+     * until the database is freed or the arena is compacted by an update. */
+    xcb_xrm_arena_t arena;
+    /* The number of entries which have been removed from the database but
+     * are still allocated in the arena. */
+    size_t num_discarded;
+
+    /* The lines which have not been parsed yet or NULL if there are none.
+     * They are parsed into entries once a query needs them. */
+    xcb_xrm_lazy_t *lazy;
+    /* Set if entries parsed from deferred lines have been appended to the
+     * entries out of order since they were sorted by position last. */
+    bool unsorted;
+
+    /* Incremented whenever the database is modified. */
+    unsigned long generation;
+
+    /* Optional cache for query results. */
+    xcb_xrm_cache_t cache;
+
+    /* Counters and timings for xcb_xrm_database_get_stats. The entries are
+     * only counted when the statistics are requested. Lookups update the
+     * counters atomically since they may run concurrently. */
+    xcb_xrm_database_stats_t stats;
+    /* Called for lookups taking at least trace_threshold nanoseconds. */
+    xcb_xrm_trace_t trace;
+    void *trace_data;
+    uint64_t trace_threshold;
+
+    /* Set once the database may be shared between threads. Lookups then only
+     * use the frozen index, which is replaced by every modification. */
+    bool concurrent;
+    /* Serializes modifications of a concurrent database. */
+    pthread_mutex_t mutex;
+    /* Set if the frozen index has to be replaced once the mutex is released. */
+    bool stale;
+    /* The number of lookups which currently use a frozen index. */
+    unsigned long readers;
+    /* Frozen indexes which have been replaced while lookups might still have
+     * been using them. */
+    xcb_xrm_frozen_t *retired;
+};
+
+/**
+ * Inserts the entry into the database. The entry must have been allocated
+ * from the database's arena.
+ *
+ */
+void xcb_xrm_database_put(xcb_xrm_database_t *database, xcb_xrm_entry_t *entry, bool override);
+
+/**
+ * Parses the deferred lines of the database which might match a query whose
+ * first name or class is the given quark.
+ *
+ */
+void xcb_xrm_database_load(xcb_xrm_database_t *database, xcb_xrm_quark_t quark);
+
+/**
+ * Changes the database to contain exactly the entries of source, reporting
+ * the specifiers of all entries which have been inserted, removed or
+ * changed. The source database is not modified.
+ *
+ * Once the arena holds more removed than live entries, the live ones are
+ * copied into a new arena. Concurrent databases keep all removed entries,
+ * since strings borrowed from them stay valid until the database is
+ * destroyed.
+ *
+ * @param changed_keys If not NULL, returns a NULL-terminated list of the
+ * changed specifiers. The list and its elements must be free'd.
+ * @returns The number of changed specifiers or a negative number on error.
+ *
+ */
+int xcb_xrm_database_update(xcb_xrm_database_t *database, xcb_xrm_database_t *source, char ***changed_keys);
+
+/**
+ * Prepares a modification of the database. For a concurrent database, this
+ * waits until all other modifications are done.
+ *
+ */
+void xcb_xrm_database_lock(xcb_xrm_database_t *database);
 
-TAILQ_HEAD(xcb_xrm_database_t, xcb_xrm_entry_t);
+/**
+ * Finishes a modification of the database. For a concurrent database, this
+ * publishes a new frozen index if the database has been modified.
+ *
+ */
+void xcb_xrm_database_unlock(xcb_xrm_database_t *database);
+
+/**
+ * Returns the frozen index to use for a lookup or NULL if the database is not
+ * frozen. Every call must be followed by @ref xcb_xrm_database_read_end once
+ * the lookup does not use the frozen index anymore.
+ *
+ */
+const xcb_xrm_frozen_t *xcb_xrm_database_read_begin(xcb_xrm_database_t *database);
+
+/**
+ * Finishes a lookup started with @ref xcb_xrm_database_read_begin.
+ *
+ */
+void xcb_xrm_database_read_end(xcb_xrm_database_t *database);
 
 #endif /* __DATABASE_H__ */
@@ -29,6 +29,11 @@
 #ifndef __ENTRY_H__
 #define __ENTRY_H__
 
+#include "externals.h"
+
+#include "arena.h"
+#include "quark.h"
+
 /** Defines where the parser is currently at. */
 typedef enum {
     /* Reading initial workspace before anything else. */
@@ -55,41 +60,106 @@ typedef enum {
     BT_LOOSE = 1
 } xcb_xrm_binding_type_t;
 
+/** The conversions of an entry's value which have been cached. */
+typedef enum {
+    EC_LONG = 1 << 0,
+    EC_BOOL = 1 << 1
+} xcb_xrm_entry_conversion_t;
+
+/* Components of entries being parsed are collected on the stack up to this
+ * number. */
+#define ENTRY_STACK_COMPONENTS 16
+
 /** One component of a resource, either in the name or class. */
 typedef struct xcb_xrm_component_t {
-    /* The type of this component. */
-    xcb_xrm_component_type_t type;
-    /* The binding type of this component. */
-    xcb_xrm_binding_type_t binding_type;
-    /* This component's name. Only useful if the type is CT_NORMAL. */
-    char *name;
-
-    TAILQ_ENTRY(xcb_xrm_component_t) components;
+    /* This component's name. Only useful if the type is CT_NORMAL. The string
+     * is owned by the quark table. */
+    const char *name;
+    /* The quark of this component's name. Only useful if the type is
+     * CT_NORMAL. */
+    xcb_xrm_quark_t quark;
+    /* The type of this component, one of xcb_xrm_component_type_t. */
+    uint8_t type;
+    /* The binding type of this component, one of xcb_xrm_binding_type_t. */
+    uint8_t binding_type;
 } xcb_xrm_component_t;
 
 /** Used in xcb_xrm_entry_parse. */
 typedef struct xcb_xrm_entry_parser_state_t {
     xcb_xrm_entry_parser_chunk_status_t chunk;
-    char buffer[4096];
+    /* The component currently being read and its length. This points either
+     * into the input or into buffer. */
+    const char *component;
+    size_t component_len;
+    /* Buffer for components which are not contiguous in the input. It is
+     * allocated on demand with buffer_size bytes. */
+    char *buffer;
     char *buffer_pos;
+    size_t buffer_size;
     xcb_xrm_binding_type_t current_binding_type;
+    /* The components which have been read so far. These are stored on the
+     * caller's stack unless there are more than ENTRY_STACK_COMPONENTS. */
+    xcb_xrm_component_t *components;
+    int num_components;
+    int size_components;
+    /* The arena to allocate the entry from or NULL to use the heap. */
+    xcb_xrm_arena_t *arena;
 } xcb_xrm_entry_parser_state_t;
 
 /**
  * Parsed structure for a single entry in the xrm database, e.g. representing
  * the parsted state of
  *     Application*class?subclass.resource.
+ *
+ * An entry is a single allocation: the components follow the entry, and the
+ * value follows the components.
  */
 typedef struct xcb_xrm_entry_t {
-    /* The value of this entry. */
+    /* The value of this entry or NULL if only a resource name has been
+     * parsed. */
     char *value;
 
-    /* The individual components making up this entry. */
-    TAILQ_HEAD(components_head, xcb_xrm_component_t) components;
+    /* The value converted by xcb_xrm_convert_to_long and
+     * xcb_xrm_convert_to_bool. Each is only valid if its flag is set in
+     * converted. The value of an entry never changes, so they are computed
+     * at most once. */
+    long long_value;
+    bool bool_value;
+    int converted;
+
+    /* Position of this entry in its database. Entries inserted later have a
+     * higher position. */
+    unsigned long position;
 
     TAILQ_ENTRY(xcb_xrm_entry_t) entries;
+
+    /* Hash over the components, which is the same for entries with the same
+     * resource specifier. */
+    uint32_t hash;
+    /* The individual components making up this entry. */
+    int num_components;
+    xcb_xrm_component_t components[];
 } xcb_xrm_entry_t;
 
+/**
+ * Allocates an entry with room for the given number of components and a value
+ * of value_size bytes, including the terminating NUL byte. If value_size is
+ * zero, the entry has no value. The caller fills in the components and then
+ * calls @ref xcb_xrm_entry_update_hash.
+ *
+ * @param arena If not NULL, the entry is allocated from this arena and must
+ * not be freed.
+ * @return The entry or NULL if memory could not be allocated.
+ *
+ */
+xcb_xrm_entry_t *xcb_xrm_entry_new(xcb_xrm_arena_t *arena, int num_components, size_t value_size);
+
+/**
+ * Computes the hash of the entry's components.
+ *
+ */
+void xcb_xrm_entry_update_hash(xcb_xrm_entry_t *entry);
+
 /**
  * Parses a specific resource string.
  *
@@ -104,6 +174,46 @@ typedef struct xcb_xrm_entry_t {
  */
 int xcb_xrm_entry_parse(const char *str, xcb_xrm_entry_t **entry, bool resource_only);
 
+/**
+ * Parses a specific resource string of the given length. The string does not
+ * need to be terminated.
+ *
+ * @param str The resource string.
+ * @param len The length of the resource string.
+ * @param entry A return struct that will contain the parsed resource. The
+ * memory will be allocated dynamically, so it must be freed.
+ * @param resource_only If true, no wildcards are allowed and only a resource
+ * name is parsed.
+ * @param arena If not NULL, all memory for the entry is allocated from this
+ * arena and the entry must not be freed.
+ *
+ * @return 0 on success, a negative error code otherwise.
+ *
+ */
+int xcb_xrm_entry_parse_length(const char *str, size_t len, xcb_xrm_entry_t **entry, bool resource_only,
+        xcb_xrm_arena_t *arena);
+
+/**
+ * Parses a resource name or class into the quarks of its components without
+ * allocating an entry. At most size quarks are stored.
+ *
+ * This accepts exactly the strings which xcb_xrm_entry_parse accepts with
+ * resource_only set.
+ *
+ * @return The number of components, which may be larger than size, or a
+ * negative error code if the string is not a valid resource name.
+ *
+ */
+int xcb_xrm_entry_parse_quarks(const char *str, xcb_xrm_quark_t *quarks, int size);
+
+/**
+ * Copies the entry into the arena. The position is not copied.
+ *
+ * @return The copy or NULL if memory could not be allocated.
+ *
+ */
+xcb_xrm_entry_t *xcb_xrm_entry_copy(xcb_xrm_entry_t *entry, xcb_xrm_arena_t *arena);
+
 /**
  * Returns the number of components of the given entry.
  *
@@ -117,12 +227,29 @@ int xcb_xrm_entry_num_components(xcb_xrm_entry_t *entry);
  */
 int xcb_xrm_entry_compare(xcb_xrm_entry_t *first, xcb_xrm_entry_t *second);
 
+/**
+ * Writes the string representation of this entry to buffer, which must be
+ * large enough, unless it is NULL. If with_value is false, only the resource
+ * specifier is written. The result is not NUL-terminated.
+ *
+ * @return The length of the string representation.
+ *
+ */
+size_t xcb_xrm_entry_format(xcb_xrm_entry_t *entry, char *buffer, bool with_value);
+
 /**
  * Returns a string representation of this entry.
  *
  */
 char *xcb_xrm_entry_to_string(xcb_xrm_entry_t *entry);
 
+/**
+ * Returns the resource specifier of an entry, i.e., its string
+ * representation without the value.
+ *
+ */
+char *xcb_xrm_entry_specifier_to_string(xcb_xrm_entry_t *entry);
+
 /**
  * Escapes magic values.
  *
@@ -130,7 +257,8 @@ char *xcb_xrm_entry_to_string(xcb_xrm_entry_t *entry);
 char *xcb_xrm_entry_escape_value(const char *value);
 
 /**
- * Frees the given entry.
+ * Frees the given entry. This must not be used for entries allocated from an
+ * arena.
  *
  * @param entry The entry to be freed.
  *
@@ -34,6 +34,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <ctype.h>
 #include <err.h>
@@ -42,8 +43,10 @@
 #include <math.h>
 #include <assert.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/queue.h>
 #include <sys/stat.h>
+#include <time.h>
 
 #include <xcb/xcb.h>
 #include <xcb/xcb_aux.h>
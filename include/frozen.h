@@ -0,0 +1,116 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * Copyright © 2016 Ingo Bürk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the names of the authors or their
+ * institutions shall not be used in advertising or otherwise to promote the
+ * sale, use or other dealings in this Software without prior written
+ * authorization from the authors.
+ *
+ */
+#ifndef __FROZEN_H__
+#define __FROZEN_H__
+
+#include "externals.h"
+
+#include "node.h"
+
+/* Index of a node or an edge which does not exist. */
+#define FROZEN_NONE (-1)
+
+/** A child of a frozen node. */
+typedef struct xcb_xrm_frozen_edge_t {
+    /* The quark of the component leading to the child. */
+    xcb_xrm_quark_t quark;
+    /* The index of the child node. */
+    int node;
+} xcb_xrm_frozen_edge_t;
+
+/**
+ * A node of the frozen index. This is the same as xcb_xrm_node_t, but the
+ * children are stored as ranges of edges sorted by quark and nodes refer to
+ * each other by their index.
+ *
+ */
+typedef struct xcb_xrm_frozen_node_t {
+    /* The entry whose components end at this node, if any. */
+    xcb_xrm_entry_t *entry;
+
+    /* The first edge and the number of edges for tightly bound normal
+     * components. */
+    int tight;
+    int num_tight;
+    /* The first edge and the number of edges for loosely bound normal
+     * components. */
+    int loose;
+    int num_loose;
+    /* The filters of the tables the edges were compiled from. */
+    uint64_t tight_filter;
+    uint64_t loose_filter;
+    /* The child for a tightly bound wildcard component or FROZEN_NONE. */
+    int tight_wildcard;
+    /* The child for a loosely bound wildcard component or FROZEN_NONE. */
+    int loose_wildcard;
+} xcb_xrm_frozen_node_t;
+
+/**
+ * A read-only copy of the index over the database entries, compiled into two
+ * flat arrays. The root node has index 0 and every node is followed by its
+ * descendants.
+ *
+ */
+typedef struct xcb_xrm_frozen_t {
+    xcb_xrm_frozen_node_t *nodes;
+    int num_nodes;
+
+    xcb_xrm_frozen_edge_t *edges;
+    int num_edges;
+
+    /* The generation of the database the index was compiled from. */
+    unsigned long generation;
+
+    /* Links frozen indexes which have been replaced, but not free'd yet. */
+    struct xcb_xrm_frozen_t *next;
+} xcb_xrm_frozen_t;
+
+/**
+ * Compiles the index below root. Returns NULL if memory could not be
+ * allocated.
+ *
+ */
+xcb_xrm_frozen_t *xcb_xrm_frozen_new(xcb_xrm_node_t *root);
+
+/**
+ * Returns the index of the child among the count edges starting at first
+ * for the given quark or FROZEN_NONE if there is no such child. filter is the
+ * filter of the edges as in xcb_xrm_node_table_t.
+ *
+ */
+int xcb_xrm_frozen_lookup(const xcb_xrm_frozen_t *frozen, int first, int count, uint64_t filter,
+        xcb_xrm_quark_t quark);
+
+/**
+ * Frees the given frozen index.
+ *
+ */
+void xcb_xrm_frozen_free(xcb_xrm_frozen_t *frozen);
+
+#endif /* __FROZEN_H__ */
@@ -0,0 +1,120 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * Copyright © 2016 Ingo Bürk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the names of the authors or their
+ * institutions shall not be used in advertising or otherwise to promote the
+ * sale, use or other dealings in this Software without prior written
+ * authorization from the authors.
+ *
+ */
+#ifndef __LAZY_H__
+#define __LAZY_H__
+
+#include "externals.h"
+
+#include "quark.h"
+
+/** A line whose parsing has been deferred. */
+typedef struct xcb_xrm_lazy_line_t {
+    /* The line without continuations is stored at this offset of the
+     * buffer. */
+    size_t offset;
+    size_t length;
+    /* The position the entry parsed from the line has in the database. */
+    unsigned long position;
+} xcb_xrm_lazy_line_t;
+
+/** The deferred lines whose first component is the same. */
+typedef struct xcb_xrm_lazy_bucket_t {
+    /* The quark of the first component or XCB_XRM_NULLQUARK for an empty
+     * slot. */
+    xcb_xrm_quark_t quark;
+    /* The lines in the order of their positions. */
+    xcb_xrm_lazy_line_t *lines;
+    size_t num_lines;
+    size_t size_lines;
+} xcb_xrm_lazy_bucket_t;
+
+/**
+ * The lines of a database which have not been parsed yet. Only lines starting
+ * with a tightly bound normal component are deferred, so they can only match
+ * queries whose first name or class is the same component. This is what they
+ * are grouped by.
+ *
+ */
+typedef struct xcb_xrm_lazy_t {
+    /* Copies of all deferred lines. */
+    char *buffer;
+    size_t length;
+    size_t size;
+
+    /* Open addressing hash table of the buckets. The number of slots is zero
+     * or a power of two. Buckets stay in the table once their lines have
+     * been taken. */
+    xcb_xrm_lazy_bucket_t *buckets;
+    size_t size_buckets;
+    size_t num_buckets;
+
+    /* The number of lines in all buckets. */
+    size_t num_lines;
+} xcb_xrm_lazy_t;
+
+/**
+ * Creates an empty set of deferred lines.
+ *
+ * @return The set or NULL if memory could not be allocated.
+ *
+ */
+xcb_xrm_lazy_t *xcb_xrm_lazy_new(void);
+
+/**
+ * Defers the first len bytes of line, which must not contain any line
+ * continuations, to be parsed once a query for the given first component is
+ * resolved. Lines must be added in the order of their positions.
+ *
+ * @return 0 on success, a negative error code otherwise.
+ *
+ */
+int xcb_xrm_lazy_add(xcb_xrm_lazy_t *lazy, xcb_xrm_quark_t quark, const char *line, size_t len,
+        unsigned long position);
+
+/**
+ * Returns the bucket of lines with the given first component or NULL if
+ * there is none. The lines stay valid until they are released with
+ * @ref xcb_xrm_lazy_release.
+ *
+ */
+xcb_xrm_lazy_bucket_t *xcb_xrm_lazy_find(xcb_xrm_lazy_t *lazy, xcb_xrm_quark_t quark);
+
+/**
+ * Removes all lines from the bucket once they have been parsed.
+ *
+ */
+void xcb_xrm_lazy_release(xcb_xrm_lazy_t *lazy, xcb_xrm_lazy_bucket_t *bucket);
+
+/**
+ * Frees the given set of deferred lines.
+ *
+ */
+void xcb_xrm_lazy_free(xcb_xrm_lazy_t *lazy);
+
+#endif /* __LAZY_H__ */
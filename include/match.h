@@ -30,6 +30,7 @@
 #define __MATCH_H__
 
 #include "database.h"
+#include "frozen.h"
 #include "resource.h"
 #include "entry.h"
 
@@ -58,6 +59,47 @@ typedef struct xcb_xrm_match_t {
 	xcb_xrm_match_flags_t *flags;
 } xcb_xrm_match_t;
 
+/* A point at which the descent for a query prefix stopped. */
+typedef struct xcb_xrm_match_frontier_item_t {
+    /* The node the descent stopped at. */
+    xcb_xrm_node_t *node;
+    /* The same for a frontier of a frozen index. */
+    int index;
+    /* The first query component which has not been matched yet. */
+    int level;
+    /* If true, only the loosely bound normal children of the node remain to be
+     * matched against the query components following the prefix. */
+    bool loose;
+    /* How the components before level were matched. */
+    xcb_xrm_match_flags_t *flags;
+} xcb_xrm_match_frontier_item_t;
+
+/* The state of the descent after matching a query prefix, which can be
+ * resumed for any number of queries sharing this prefix. */
+typedef struct xcb_xrm_match_frontier_t {
+    xcb_xrm_database_t *database;
+
+    /* The frozen index the items refer to and its generation. This is only
+     * used for concurrent databases, which must not be matched against the
+     * index itself. */
+    const xcb_xrm_frozen_t *frozen;
+    unsigned long generation;
+
+    /* The number of components of the prefix. */
+    int length;
+    /* The quarks of the full query. The prefix is stored at the beginning,
+     * the rest is filled in for each resolved query. */
+    xcb_xrm_quark_t *names;
+    xcb_xrm_quark_t *classes;
+    bool with_classes;
+    xcb_xrm_match_flags_t *flags;
+    int size_query;
+
+    xcb_xrm_match_frontier_item_t *items;
+    int num_items;
+    int size_items;
+} xcb_xrm_match_frontier_t;
+
 /**
  * Finds the matching entry in the database given a full name / class query string.
  *
@@ -65,4 +107,50 @@ typedef struct xcb_xrm_match_t {
 int xcb_xrm_match(xcb_xrm_database_t *database, xcb_xrm_entry_t *query_name, xcb_xrm_entry_t *query_class,
         xcb_xrm_resource_t *resource);
 
+/**
+ * Finds the matching entry in the database given the quarks of the name and
+ * class query components.
+ *
+ * @param names The quarks of the name query's components.
+ * @param classes The quarks of the class query's components or NULL.
+ * @param length The number of components in both names and classes.
+ *
+ */
+int xcb_xrm_match_quarks(xcb_xrm_database_t *database, const xcb_xrm_quark_t *names,
+        const xcb_xrm_quark_t *classes, int length, xcb_xrm_resource_t *resource);
+
+/**
+ * Matches the given query prefix against the database and stores the state of
+ * the descent in frontier. The state can be resumed by
+ * @ref xcb_xrm_match_frontier_resolve and must be free'd with
+ * @ref xcb_xrm_match_frontier_free.
+ *
+ * @param names The quarks of the name prefix's components.
+ * @param classes The quarks of the class prefix's components or NULL.
+ * @param length The number of components in both names and classes. This may
+ * be zero.
+ *
+ */
+int xcb_xrm_match_frontier_init(xcb_xrm_database_t *database, xcb_xrm_match_frontier_t *frontier,
+        const xcb_xrm_quark_t *names, const xcb_xrm_quark_t *classes, int length);
+
+/**
+ * Finds the matching entry in the database for the query consisting of the
+ * frontier's prefix followed by the given components.
+ *
+ * @param names The quarks of the name components following the prefix.
+ * @param classes The quarks of the class components following the prefix or
+ * NULL. This may only be given if the prefix was given with classes.
+ * @param length The number of components in both names and classes.
+ *
+ */
+int xcb_xrm_match_frontier_resolve(xcb_xrm_match_frontier_t *frontier, const xcb_xrm_quark_t *names,
+        const xcb_xrm_quark_t *classes, int length, xcb_xrm_resource_t *resource);
+
+/**
+ * Frees the state stored in frontier.
+ *
+ */
+void xcb_xrm_match_frontier_free(xcb_xrm_match_frontier_t *frontier);
+
 #endif /* __MATCH_H__ */
@@ -0,0 +1,134 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * Copyright © 2016 Ingo Bürk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the names of the authors or their
+ * institutions shall not be used in advertising or otherwise to promote the
+ * sale, use or other dealings in this Software without prior written
+ * authorization from the authors.
+ *
+ */
+#ifndef __NODE_H__
+#define __NODE_H__
+
+#include "externals.h"
+
+#include "entry.h"
+#include "quark.h"
+
+typedef struct xcb_xrm_node_t xcb_xrm_node_t;
+
+#define NODE_FILTER_BIT(quark) ((uint64_t) 1 << ((quark) & 63))
+
+/** Hash table mapping the quark of a component to the child node. */
+typedef struct xcb_xrm_node_table_t {
+    /* Open addressing slots, empty slots are NULL. */
+    xcb_xrm_node_t **slots;
+    /* The number of slots. This is zero or a power of two. */
+    size_t size;
+    /* The number of used slots. */
+    size_t count;
+    /* Has the bit NODE_FILTER_BIT(quark) set for the quark of every child.
+     * Most lookups are for quarks which are not in the table, and most of
+     * them can be answered from this alone. */
+    uint64_t filter;
+} xcb_xrm_node_table_t;
+
+/**
+ * A node in the index over the database entries.
+ *
+ * Every path from the root node describes a sequence of components; the
+ * node at the end of the path holds the entry for exactly this sequence, if
+ * there is one. Children are kept in separate tables for tight and loose
+ * bindings so that a lookup only has to consider the children which can
+ * possibly match a given query component.
+ *
+ */
+struct xcb_xrm_node_t {
+    /* The quark of the component leading to this node. */
+    xcb_xrm_quark_t quark;
+    /* The entry whose components end at this node, if any. */
+    xcb_xrm_entry_t *entry;
+
+    /* Children for tightly bound normal components. */
+    xcb_xrm_node_table_t tight;
+    /* Children for loosely bound normal components. */
+    xcb_xrm_node_table_t loose;
+    /* Child for a tightly bound wildcard component ("?"). */
+    xcb_xrm_node_t *tight_wildcard;
+    /* Child for a loosely bound wildcard component ("*?"). */
+    xcb_xrm_node_t *loose_wildcard;
+};
+
+/**
+ * Creates a new, empty node.
+ *
+ */
+xcb_xrm_node_t *xcb_xrm_node_new(void);
+
+/**
+ * Returns the child of the given table for the given quark or NULL if there
+ * is no such child.
+ *
+ */
+xcb_xrm_node_t *xcb_xrm_node_lookup(xcb_xrm_node_table_t *table, xcb_xrm_quark_t quark);
+
+/**
+ * Returns the node describing the components of the given entry.
+ * If create is true, missing nodes are created. Otherwise, NULL is returned if
+ * the node does not exist. NULL is also returned if memory could not be
+ * allocated.
+ *
+ */
+xcb_xrm_node_t *xcb_xrm_node_find(xcb_xrm_node_t *root, xcb_xrm_entry_t *entry, bool create);
+
+/**
+ * Removes the entry from the node describing its components, if it is that
+ * node's entry. Nodes which are left without an entry and without children
+ * are free'd.
+ *
+ */
+void xcb_xrm_node_remove(xcb_xrm_node_t *root, xcb_xrm_entry_t *entry);
+
+/** Receives an entry which is no longer referenced by a merged tree. */
+typedef void (*xcb_xrm_node_discard_t)(xcb_xrm_entry_t *entry, void *data);
+
+/**
+ * Moves all nodes below source into the tree below target. Where both trees
+ * have a node for the same components, the entry of source replaces the one
+ * of target if override is set and is dropped otherwise. Every entry which
+ * is dropped this way is passed to discard.
+ *
+ * On success, source has been free'd. If memory could not be allocated, a
+ * negative error code is returned and neither tree is modified.
+ *
+ */
+int xcb_xrm_node_merge(xcb_xrm_node_t *target, xcb_xrm_node_t *source, bool override,
+        xcb_xrm_node_discard_t discard, void *data);
+
+/**
+ * Frees the given node and all of its children. Entries referenced by the
+ * nodes are not freed.
+ *
+ */
+void xcb_xrm_node_free(xcb_xrm_node_t *node);
+
+#endif /* __NODE_H__ */
@@ -0,0 +1,55 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * Copyright © 2016 Ingo Bürk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the names of the authors or their
+ * institutions shall not be used in advertising or otherwise to promote the
+ * sale, use or other dealings in this Software without prior written
+ * authorization from the authors.
+ *
+ */
+#ifndef __QUARK_H__
+#define __QUARK_H__
+
+#include "externals.h"
+
+#include "xcb_xrm.h"
+
+/**
+ * Returns the quark for the first len bytes of str, allocating a new quark if
+ * the string has not been seen before.
+ * Quarks are process-wide and are never freed. If interned is not NULL, it is
+ * set to the string owned by the quark table, which saves the caller from
+ * taking the lock in @ref xcb_xrm_quark_string.
+ *
+ * @return The quark or XCB_XRM_NULLQUARK if memory could not be allocated.
+ *
+ */
+xcb_xrm_quark_t xcb_xrm_quark_intern(const char *str, size_t len, const char **interned);
+
+/**
+ * Returns the string represented by the given quark or NULL if the quark is
+ * unknown. The string is owned by the quark table and must not be modified.
+ *
+ */
+const char *xcb_xrm_quark_string(xcb_xrm_quark_t quark);
+
+#endif /* __QUARK_H__ */
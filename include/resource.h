@@ -37,7 +37,9 @@
 #include "convert.h"
 
 typedef struct xcb_xrm_resource_t {
-    char *value;
+    /* The database entry the resource was found in. Its value is owned by
+     * the database. */
+    xcb_xrm_entry_t *entry;
 } xcb_xrm_resource_t;
 
 #endif /* __RESOURCE_H__ */
@@ -47,9 +47,33 @@
 
 int str2long(long *out, const char *input, const int base);
 
+uint32_t hash_bytes(const char *data, size_t len);
+
+uint64_t hash_bytes_64(const char *data, size_t len);
+
+const char *find_chars(const char *str, const char *end, char first, char second, char third);
+
 char *get_home_dir_file(const char *filename);
 
-char *file_get_contents(const char *filename);
+uint64_t get_time(void);
+
+/* The contents of a file, which are not NUL-terminated. */
+typedef struct file_contents_t {
+    char *data;
+    size_t length;
+    /* Whether data is a mapping of the file rather than a heap copy. */
+    bool mapped;
+} file_contents_t;
+
+int file_map_contents(const char *filename, file_contents_t *contents);
+
+void file_unmap_contents(file_contents_t *contents);
+
+xcb_get_property_cookie_t xcb_util_get_property_request(xcb_connection_t *conn, xcb_window_t window,
+        xcb_atom_t atom, xcb_atom_t type, size_t size);
+
+char *xcb_util_get_property_reply(xcb_connection_t *conn, xcb_get_property_cookie_t cookie,
+        xcb_window_t window, xcb_atom_t atom, xcb_atom_t type);
 
 char *xcb_util_get_property(xcb_connection_t *conn, xcb_window_t window, xcb_atom_t atom,
         xcb_atom_t type, size_t size);
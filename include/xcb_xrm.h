@@ -30,6 +30,8 @@
 #define __XCB_XRM_H__
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <xcb/xcb.h>
 
 #ifdef __cplusplus
@@ -78,6 +80,95 @@ extern "C" {
  */
 typedef struct xcb_xrm_database_t xcb_xrm_database_t;
 
+/**
+ * @typedef xcb_xrm_quark_t
+ * Interned representation of a resource name or class component.
+ *
+ * Quarks are the xcb equivalent of XrmQuark. Equal strings are always mapped
+ * to the same quark, so looking up resources by quarks avoids parsing and
+ * comparing strings. Quarks are valid for the lifetime of the process.
+ */
+typedef int xcb_xrm_quark_t;
+
+/** The quark which does not represent any string. */
+#define XCB_XRM_NULLQUARK ((xcb_xrm_quark_t) 0)
+
+/**
+ * @struct xcb_xrm_resource_manager_cookie_t
+ * Cookie for the request sent by @ref
+ * xcb_xrm_database_from_resource_manager_request ().
+ */
+typedef struct xcb_xrm_resource_manager_cookie_t {
+    /** The cookie of the GetProperty request. */
+    xcb_get_property_cookie_t cookie;
+    /** The window the property is read from. */
+    xcb_window_t window;
+} xcb_xrm_resource_manager_cookie_t;
+
+/**
+ * @struct xcb_xrm_search_list_t
+ * The result of matching a resource name / class prefix against a database.
+ *
+ * Search lists are the xcb equivalent of XrmSearchList. They are created by
+ * @ref xcb_xrm_database_get_search_list () and can be used to look up any
+ * number of resources sharing the prefix. A search list must always be free'd
+ * by using @ref xcb_xrm_search_list_free ().
+ */
+typedef struct xcb_xrm_search_list_t xcb_xrm_search_list_t;
+
+/**
+ * @struct xcb_xrm_database_stats_t
+ * Statistics about a database, as returned by @ref xcb_xrm_database_get_stats
+ * ().
+ *
+ * Lookups answered by the cache (see @ref xcb_xrm_database_set_cache_size ())
+ * are not included; @ref xcb_xrm_database_get_cache_stats () reports them.
+ */
+typedef struct xcb_xrm_database_stats_t {
+    /** The number of entries. */
+    size_t num_entries;
+    /** The total number of components of all entries. */
+    size_t num_components;
+    /** The number of bytes allocated for entries, components and values,
+     * including entries which have been replaced or removed. */
+    size_t storage_size;
+
+    /** The number of lookups resolved against the database. */
+    unsigned long lookups;
+    /** The number of matching entries these lookups had to choose from. */
+    unsigned long candidates;
+    /** The number of inserted entries whose resource specifier already
+     * existed, whether they replaced the existing entry or not. */
+    unsigned long duplicates;
+
+    /** Nanoseconds spent parsing the database, including included files. */
+    uint64_t parse_time;
+    /** Nanoseconds spent waiting for the RESOURCE_MANAGER property. */
+    uint64_t fetch_time;
+    /** Nanoseconds spent in lookups. Lookups are only timed while a trace
+     * callback is installed with @ref xcb_xrm_database_set_trace (). */
+    uint64_t match_time;
+} xcb_xrm_database_stats_t;
+
+/**
+ * @typedef xcb_xrm_trace_t
+ * Receives lookups which took longer than the threshold passed to @ref
+ * xcb_xrm_database_set_trace ().
+ *
+ * The name and class are the fully qualified query, e.g., "Xft.dpi"; class is
+ * NULL if the lookup did not use a class. Both are only valid during the call.
+ */
+typedef void (*xcb_xrm_trace_t)(void *data, const char *name, const char *class, uint64_t duration);
+
+/**
+ * @typedef xcb_xrm_writer_t
+ * Receives the output of @ref xcb_xrm_database_write ().
+ *
+ * The writer is called with consecutive chunks of the output, which are not
+ * NUL-terminated. It returns 0 on success; a negative value aborts writing.
+ */
+typedef int (*xcb_xrm_writer_t)(void *data, const char *buffer, size_t length);
+
 /**
  * Creates a database similarly to XGetDefault(). For typical applications,
  * this is the recommended way to construct the resource database.
@@ -102,12 +193,29 @@ typedef struct xcb_xrm_database_t xcb_xrm_database_t;
  * part, but is not exactly the same. In particular, XGetDefault() does not
  * consider $HOME/.Xresources.
  *
+ * The files are loaded on threads of their own while the property is being
+ * fetched from the X server, so that reading and parsing them does not add to
+ * the round-trip. Files which turn out not to be needed are discarded.
+ *
  * @param conn XCB connection.
  * @returns The constructed database. Can return NULL, e.g., if the screen
  * cannot be determined.
  */
 xcb_xrm_database_t *xcb_xrm_database_from_default(xcb_connection_t *conn);
 
+/**
+ * Creates a database like @ref xcb_xrm_database_from_default, but loads the
+ * RESOURCE_MANAGER property with @ref
+ * xcb_xrm_database_from_resource_manager_shared. Clients which are started
+ * often, e.g., terminals or launchers, can use this to avoid
+ * parsing the same resources over and over again.
+ *
+ * @param conn XCB connection.
+ * @returns The constructed database. Can return NULL, e.g., if the screen
+ * cannot be determined.
+ */
+xcb_xrm_database_t *xcb_xrm_database_from_default_shared(xcb_connection_t *conn);
+
 /**
  * Loads the RESOURCE_MANAGER property and creates a database with its
  * contents. If the database could not be created, this function will return
@@ -121,6 +229,113 @@ xcb_xrm_database_t *xcb_xrm_database_from_default(xcb_connection_t *conn);
  */
 xcb_xrm_database_t *xcb_xrm_database_from_resource_manager(xcb_connection_t *conn, xcb_screen_t *screen);
 
+/**
+ * Sends the request for the RESOURCE_MANAGER property without waiting for
+ * the reply. The database can then be created by passing the returned cookie
+ * to @ref xcb_xrm_database_from_resource_manager_reply.
+ *
+ * This allows to send other requests before waiting for the reply, which
+ * saves round-trips to the X server compared to using @ref
+ * xcb_xrm_database_from_resource_manager.
+ *
+ * @param conn A working XCB connection.
+ * @param screen The xcb_screen_t* screen to use.
+ * @returns The cookie for the request.
+ *
+ * @ingroup xcb_xrm_database_t
+ */
+xcb_xrm_resource_manager_cookie_t xcb_xrm_database_from_resource_manager_request(xcb_connection_t *conn,
+        xcb_screen_t *screen);
+
+/**
+ * Waits for the reply to the request sent by @ref
+ * xcb_xrm_database_from_resource_manager_request and creates a database with
+ * the contents of the RESOURCE_MANAGER property. If the database could not be
+ * created, this function will return NULL.
+ *
+ * Every request must be followed by exactly one call to this function.
+ *
+ * @param conn The XCB connection the request was sent on.
+ * @param cookie The cookie returned for the request.
+ * @returns The database described by the RESOURCE_MANAGER property.
+ *
+ * @ingroup xcb_xrm_database_t
+ */
+xcb_xrm_database_t *xcb_xrm_database_from_resource_manager_reply(xcb_connection_t *conn,
+        xcb_xrm_resource_manager_cookie_t cookie);
+
+/**
+ * Loads the RESOURCE_MANAGER property like @ref
+ * xcb_xrm_database_from_resource_manager, but shares the parsed database with
+ * other clients of the same user through POSIX shared memory.
+ *
+ * The snapshot is identified by the display, which is taken from $DISPLAY,
+ * and a hash of the property's contents. If the snapshot exists, the database
+ * is loaded from it like with @ref xcb_xrm_database_from_blob. This saves
+ * parsing the property, but every client still builds its own database from
+ * the snapshot, so it only takes somewhat less time. Otherwise, the property
+ * is parsed and the snapshot is published for the clients started after this
+ * one.
+ *
+ * Only the most recently published snapshot of every display is kept; the
+ * previous one is removed from shared memory when it is superseded, e.g.,
+ * after running "xrdb -merge". Snapshots which have been left incomplete by
+ * a client that crashed are removed and published again. Snapshots can also
+ * be removed from shared memory at any time, e.g., by deleting them from
+ * /dev/shm on Linux.
+ *
+ * @param conn A working XCB connection.
+ * @param screen The xcb_screen_t* screen to use.
+ * @returns The database described by the RESOURCE_MANAGER property.
+ *
+ * @ingroup xcb_xrm_database_t
+ */
+xcb_xrm_database_t *xcb_xrm_database_from_resource_manager_shared(xcb_connection_t *conn, xcb_screen_t *screen);
+
+/**
+ * Loads the RESOURCE_MANAGER property like @ref
+ * xcb_xrm_database_from_resource_manager, but parses it lazily as described
+ * for @ref xcb_xrm_database_from_string_lazy.
+ *
+ * @param conn A working XCB connection.
+ * @param screen The xcb_screen_t* screen to use.
+ * @returns The database described by the RESOURCE_MANAGER property.
+ *
+ * @ingroup xcb_xrm_database_t
+ */
+xcb_xrm_database_t *xcb_xrm_database_from_resource_manager_lazy(xcb_connection_t *conn, xcb_screen_t *screen);
+
+/**
+ * Loads the RESOURCE_MANAGER property again and updates the database to match
+ * it, e.g., after receiving a PropertyNotify event for the property.
+ *
+ * Only entries which have been inserted, removed or changed are applied. This
+ * is the same as removing the removed entries and then inserting the others
+ * by using @ref xcb_xrm_database_put_resource. The database must have been
+ * created from the RESOURCE_MANAGER property, since all entries which are not
+ * in the property are removed.
+ *
+ * The memory of removed and replaced entries is reclaimed once it outweighs
+ * the memory of the remaining entries. For a database shared between threads
+ * (see @ref xcb_xrm_database_enable_concurrency), it is only reclaimed when
+ * the database is destroyed, so such a database grows with every changed
+ * entry.
+ *
+ * @param database The database to update.
+ * @param conn A working XCB connection.
+ * @param screen The xcb_screen_t* screen to use.
+ * @param changed_keys If not NULL, returns a NULL-terminated list of the
+ * resource specifiers which have been inserted, removed or changed, e.g.,
+ * "*foreground". The list and each of its elements must be free'd. If nothing
+ * changed, NULL is returned.
+ * @returns The number of changed resource specifiers or a negative number on
+ * error.
+ *
+ * @ingroup xcb_xrm_database_t
+ */
+int xcb_xrm_database_update_from_resource_manager(xcb_xrm_database_t *database, xcb_connection_t *conn,
+        xcb_screen_t *screen, char ***changed_keys);
+
 /**
  * Creates a database from the given string.
  * If the database could not be created, this function will return NULL.
@@ -132,6 +347,34 @@ xcb_xrm_database_t *xcb_xrm_database_from_resource_manager(xcb_connection_t *con
  */
 xcb_xrm_database_t *xcb_xrm_database_from_string(const char *str);
 
+/**
+ * Creates a database from the given string like @ref
+ * xcb_xrm_database_from_string, but defers parsing most of its lines until
+ * they are needed.
+ *
+ * Lines starting with a tightly bound component, e.g., "XTerm*background",
+ * can only match queries whose first name or class is this component. These
+ * lines are only split off and grouped by their first component when the
+ * database is created. All lines of a group are parsed by the first query
+ * which could match one of them. Clients which load a large database but only
+ * query the resources of their own application therefore never parse most of
+ * it.
+ *
+ * The database behaves exactly like one created by @ref
+ * xcb_xrm_database_from_string. Functions which need all entries, e.g., @ref
+ * xcb_xrm_database_to_string or @ref xcb_xrm_database_combine, parse all
+ * remaining lines first. Since queries may modify the database, it must not
+ * be queried by several threads at the same time unless @ref
+ * xcb_xrm_database_enable_concurrency has been called, which also parses all
+ * remaining lines.
+ *
+ * @param str The resource string.
+ * @returns The database described by the resource string.
+ *
+ * @ingroup xcb_xrm_database_t
+ */
+xcb_xrm_database_t *xcb_xrm_database_from_string_lazy(const char *str);
+
 /**
  * Creates a database from a given file.
  * If the file cannot be found or opened, NULL is returned.
@@ -141,6 +384,38 @@ xcb_xrm_database_t *xcb_xrm_database_from_string(const char *str);
  */
 xcb_xrm_database_t *xcb_xrm_database_from_file(const char *filename);
 
+/**
+ * Creates a database from the given string like @ref
+ * xcb_xrm_database_from_string, but parses it on several threads.
+ *
+ * The string is split into parts at line boundaries, which are parsed in
+ * parallel. Every include directive is handled as a part of its own, so files
+ * included by the string are parsed in parallel, too. The parts are then
+ * combined in their original order, so the result is the same as the one of
+ * @ref xcb_xrm_database_from_string. Small strings without include
+ * directives are parsed on the calling thread.
+ *
+ * @param str The resource string.
+ * @param num_threads The maximum number of threads to use, including the
+ * calling thread. If zero or negative, one thread per online processor is
+ * used.
+ * @returns The database described by the resource string.
+ */
+xcb_xrm_database_t *xcb_xrm_database_from_string_parallel(const char *str, int num_threads);
+
+/**
+ * Creates a database from a given file like @ref xcb_xrm_database_from_file,
+ * but parses it on several threads as described for @ref
+ * xcb_xrm_database_from_string_parallel.
+ *
+ * @param filename Valid filename.
+ * @param num_threads The maximum number of threads to use, including the
+ * calling thread. If zero or negative, one thread per online processor is
+ * used.
+ * @returns The database described by the file's contents.
+ */
+xcb_xrm_database_t *xcb_xrm_database_from_file_parallel(const char *filename, int num_threads);
+
 /**
  * Returns a string representation of a database.
  * The string is owned by the caller and must be free'd.
@@ -150,6 +425,61 @@ xcb_xrm_database_t *xcb_xrm_database_from_file(const char *filename);
  */
 char *xcb_xrm_database_to_string(xcb_xrm_database_t *database);
 
+/**
+ * Writes the string representation of a database, as returned by @ref
+ * xcb_xrm_database_to_string, without building it in memory as a whole. The
+ * output is passed to writer in chunks of a few kilobytes, so that it can,
+ * e.g., be written straight to a file descriptor.
+ *
+ * The writer must not modify the database.
+ *
+ * @param database The database to write.
+ * @param writer Called with consecutive chunks of the string representation.
+ * @param data Passed to writer.
+ * @returns 0 on success, a negative error code otherwise, including if the
+ * writer failed.
+ */
+int xcb_xrm_database_write(xcb_xrm_database_t *database, xcb_xrm_writer_t writer, void *data);
+
+/**
+ * Serializes the database into a compact binary format which can be loaded
+ * with @ref xcb_xrm_database_from_blob without parsing the string
+ * representation returned by @ref xcb_xrm_database_to_string. The entries and
+ * the index are still built when loading it. This is useful to hand the same
+ * database to many clients.
+ *
+ * The blob does not contain any pointers, so it can be stored in a file or
+ * shared memory. It can only be loaded on machines with the same byte order
+ * and by versions of this library which know its format.
+ *
+ * @param database The database to serialize.
+ * @param blob Returns the serialized database, which must be free'd.
+ * @param length Returns the size of the blob in bytes.
+ * @returns 0 on success, a negative error code otherwise.
+ */
+int xcb_xrm_database_serialize(xcb_xrm_database_t *database, void **blob, size_t *length);
+
+/**
+ * Creates a database from a blob created by @ref xcb_xrm_database_serialize.
+ * The database does not refer to the blob, which can be free'd immediately.
+ * The returned database is already frozen (see @ref xcb_xrm_database_freeze).
+ *
+ * @param blob The serialized database.
+ * @param length The size of the blob in bytes.
+ * @returns The database or NULL if the blob is not valid.
+ */
+xcb_xrm_database_t *xcb_xrm_database_from_blob(const void *blob, size_t length);
+
+/**
+ * Creates a database from a file containing a blob created by @ref
+ * xcb_xrm_database_serialize. If the file cannot be found or opened, or does
+ * not contain a valid blob, NULL is returned.
+ *
+ * @param filename Valid filename.
+ * @returns The database described by the file's contents.
+ */
+xcb_xrm_database_t *xcb_xrm_database_from_blob_file(const char *filename);
+
 /**
  * Combines two databases.
  * The entries from the source database are stored in the target database. If
@@ -195,6 +525,100 @@ void xcb_xrm_database_put_resource(xcb_xrm_database_t **database, const char *re
  */
 void xcb_xrm_database_put_resource_line(xcb_xrm_database_t **database, const char *line);
 
+/**
+ * Returns statistics about the database, e.g., to find out whether a slow
+ * startup is caused by fetching the resources, parsing them or looking them
+ * up.
+ *
+ * @param database The database to inspect.
+ * @param stats Returns the statistics.
+ * @returns 0 on success, a negative error code otherwise.
+ */
+int xcb_xrm_database_get_stats(xcb_xrm_database_t *database, xcb_xrm_database_stats_t *stats);
+
+/**
+ * Installs a callback which is called for every lookup taking at least
+ * threshold nanoseconds. While a callback is installed, all lookups are timed
+ * and their time is added to the match_time statistic. Passing NULL removes
+ * the callback.
+ *
+ * The callback must be installed before the database is used by several
+ * threads. For a concurrent database it can be called from any thread
+ * looking up resources.
+ *
+ * @param database The database to trace.
+ * @param trace The callback or NULL.
+ * @param data Passed to the callback.
+ * @param threshold The minimum duration of the lookups to report.
+ */
+void xcb_xrm_database_set_trace(xcb_xrm_database_t *database, xcb_xrm_trace_t trace, void *data,
+        uint64_t threshold);
+
+/**
+ * Compiles the database into a compact, read-only layout which is used for
+ * all further queries until the database is modified.
+ *
+ * Applications which do not modify the database after loading it should
+ * freeze it to speed up queries. Modifying a frozen database is still
+ * possible, but discards the compiled layout, so the database must be
+ * frozen again afterwards.
+ *
+ * @param database The database to freeze.
+ * @returns 0 on success, a negative error code otherwise.
+ */
+int xcb_xrm_database_freeze(xcb_xrm_database_t *database);
+
+/**
+ * Allows the database to be used by several threads at the same time.
+ *
+ * Afterwards, any number of threads may look up resources without blocking
+ * each other, even while another thread modifies the database by using @ref
+ * xcb_xrm_database_put_resource, @ref xcb_xrm_database_put_resource_line or
+ * @ref xcb_xrm_database_combine. Modifications are serialized and, once
+ * complete, publish a new frozen copy of the database (see @ref
+ * xcb_xrm_database_freeze). Lookups which are running at that time finish
+ * using the previous copy.
+ *
+ * Since every modification copies the index, many resources should be
+ * added at once by using @ref xcb_xrm_database_combine. Query results are not
+ * cached for concurrent databases. Strings returned by @ref
+ * xcb_xrm_resource_get_string_borrowed and the other functions returning
+ * borrowed strings stay valid until the database is destroyed.
+ *
+ * The database must not be destroyed while other threads are still using it.
+ * Concurrency cannot be disabled again.
+ *
+ * @param database The database to share between threads.
+ * @returns 0 on success, a negative error code otherwise.
+ */
+int xcb_xrm_database_enable_concurrency(xcb_xrm_database_t *database);
+
+/**
+ * Enables a cache for the results of @ref xcb_xrm_resource_get_string and the
+ * functions based on it. The cache holds up to size results and is
+ * invalidated whenever the database is modified.
+ *
+ * Applications which repeatedly query the same resources, e.g., once for
+ * every instance of a widget, benefit from enabling the cache. By default,
+ * the cache is disabled. Changing the size drops all cached results.
+ *
+ * @param database The database to enable the cache for.
+ * @param size The number of results to cache. Zero disables the cache.
+ * @returns 0 on success, a negative error code otherwise.
+ */
+int xcb_xrm_database_set_cache_size(xcb_xrm_database_t *database, size_t size);
+
+/**
+ * Returns how many queries have been answered by the cache and how many had
+ * to be resolved against the database. This can be used to choose a size for
+ * @ref xcb_xrm_database_set_cache_size.
+ *
+ * @param database The database to inspect.
+ * @param hits Returns the number of queries answered by the cache.
+ * @param misses Returns the number of queries which were not cached.
+ */
+void xcb_xrm_database_get_cache_stats(xcb_xrm_database_t *database, unsigned long *hits, unsigned long *misses);
+
 /**
  * Destroys the given database.
  *
@@ -223,7 +647,8 @@ char *xcb_xrm_resource_get_string(xcb_xrm_database_t *database,
 /**
  * Returns the long value of a resource.
  * This is a convenience function which calls @ref xcb_xrm_resource_get_string
- * and @ref xcb_xrm_convert_to_long.
+ * and @ref xcb_xrm_convert_to_long. The converted value is kept with the
+ * resource, so repeated calls only have to look it up.
  *
  * @param database The database to query.
  * @param res_name The fully qualified resource name string.
@@ -238,7 +663,8 @@ long xcb_xrm_resource_get_long(xcb_xrm_database_t *database,
 /**
  * Returns the bool value of a resource.
  * This is a convenience function which calls @ref xcb_xrm_resource_get_string
- * and @ref xcb_xrm_convert_to_bool.
+ * and @ref xcb_xrm_convert_to_bool. The converted value is kept with the
+ * resource, so repeated calls only have to look it up.
  *
  * @param database The database to query.
  * @param res_name The fully qualified resource name string.
@@ -250,6 +676,174 @@ long xcb_xrm_resource_get_long(xcb_xrm_database_t *database,
 bool xcb_xrm_resource_get_bool(xcb_xrm_database_t *database,
         const char *res_name, const char *res_class);
 
+/**
+ * Returns the string value of a resource without copying it.
+ * If the resource cannot be found, NULL is returned.
+ *
+ * This avoids allocating memory for the result, which makes it the preferred
+ * way to look up resources which are only read.
+ *
+ * The string is owned by the database and must neither be modified nor
+ * free'd. It is only valid until the database is modified or destroyed.
+ *
+ * @param database The database to query.
+ * @param res_name The fully qualified resource name string.
+ * @param res_class The fully qualified resource class string. This argument
+ * may be left empty / NULL, but if given, it must contain the same number of
+ * components as res_name.
+ * @returns The string value of the resource or NULL otherwise.
+ */
+const char *xcb_xrm_resource_get_string_borrowed(xcb_xrm_database_t *database,
+        const char *res_name, const char *res_class);
+
+/**
+ * Returns the string value of a resource given the quarks of the name and
+ * class components. This is equivalent to @ref xcb_xrm_resource_get_string,
+ * but avoids parsing the query strings.
+ * If the resource cannot be found, NULL is returned.
+ *
+ * Note that the string is owned by the caller and must be free'd.
+ *
+ * @param database The database to query.
+ * @param res_names The quarks of the fully qualified resource name,
+ * terminated by XCB_XRM_NULLQUARK.
+ * @param res_classes The quarks of the fully qualified resource class,
+ * terminated by XCB_XRM_NULLQUARK. This argument may be NULL, but if given,
+ * it must contain the same number of components as res_names.
+ * @returns The string value of the resource or NULL otherwise.
+ */
+char *xcb_xrm_resource_get_string_q(xcb_xrm_database_t *database,
+        const xcb_xrm_quark_t *res_names, const xcb_xrm_quark_t *res_classes);
+
+/**
+ * Looks up the string values of several resources sharing a common prefix.
+ * The prefix is matched against the database only once, which makes this
+ * considerably faster than looking up each resource on its own.
+ *
+ * The i-th resource is looked up with the name prefix_name.leaf_names[i] and
+ * the class prefix_class.leaf_classes[i]. If it cannot be found, the i-th
+ * element of out_values is set to NULL.
+ *
+ * The strings are owned by the database and must neither be modified nor
+ * free'd. They are only valid until the database is modified or destroyed.
+ *
+ * @param database The database to query.
+ * @param prefix_name The name components shared by all resources, e.g.,
+ * "myapp.button". This argument may be left empty / NULL to look up the leaves
+ * on their own.
+ * @param prefix_class The class components shared by all resources. This
+ * argument may be left empty / NULL, but if given, it must contain the same
+ * number of components as prefix_name.
+ * @param leaf_names The remaining name components of each resource, e.g.,
+ * "font". Each of them may consist of multiple components.
+ * @param leaf_classes The remaining class components of each resource or NULL
+ * to look up all resources without a class. Elements may be left empty /
+ * NULL, but if given, they must contain the same number of components as the
+ * corresponding leaf name.
+ * @param n The number of resources to look up.
+ * @param out_values An array of n elements which the values are stored in.
+ * @returns The number of resources which have been found or a negative
+ * number on error.
+ */
+int xcb_xrm_resource_get_batch(xcb_xrm_database_t *database,
+        const char *prefix_name, const char *prefix_class,
+        const char **leaf_names, const char **leaf_classes, size_t n, const char **out_values);
+
+/**
+ * Matches the given resource name / class prefix against the database for
+ * looking up resources sharing this prefix with @ref
+ * xcb_xrm_search_list_get_resource (). This is the equivalent of
+ * XrmQGetSearchList().
+ *
+ * The search list is only valid until the database is modified or destroyed.
+ * Search lists of a database shared between threads (see @ref
+ * xcb_xrm_database_enable_concurrency) stay valid when it is modified and
+ * look up resources without blocking, like all other lookups.
+ *
+ * @param database The database to query.
+ * @param names The name components shared by all resources, e.g.,
+ * "myapp.button". This argument may be left empty / NULL to look up resources
+ * on their own.
+ * @param classes The class components shared by all resources. This argument
+ * may be left empty / NULL, but if given, it must contain the same number of
+ * components as names.
+ * @returns The search list or NULL on error.
+ */
+xcb_xrm_search_list_t *xcb_xrm_database_get_search_list(xcb_xrm_database_t *database,
+        const char *names, const char *classes);
+
+/**
+ * Returns the string value of the resource consisting of the search list's
+ * prefix followed by the given components. This is the equivalent of
+ * XrmQGetSearchResource() and yields the same result as @ref
+ * xcb_xrm_resource_get_string () for the full resource name and class.
+ * If the resource cannot be found, NULL is returned.
+ *
+ * The string is owned by the database and must neither be modified nor
+ * free'd. It is only valid until the database is modified or destroyed.
+ *
+ * A search list must not be used by several threads at the same time.
+ *
+ * @param list The search list to use.
+ * @param leaf_name The remaining resource name components, e.g., "font".
+ * @param leaf_class The remaining resource class components. This argument
+ * may be left empty / NULL, but if given, it must contain the same number of
+ * components as leaf_name and the search list must have been created with a
+ * class.
+ * @returns The string value of the resource or NULL otherwise.
+ */
+const char *xcb_xrm_search_list_get_resource(xcb_xrm_search_list_t *list,
+        const char *leaf_name, const char *leaf_class);
+
+/**
+ * Destroys the given search list.
+ *
+ * @param list The search list to destroy.
+ */
+void xcb_xrm_search_list_free(xcb_xrm_search_list_t *list);
+
+/**
+ * Returns the quark for the given string, creating it if necessary.
+ *
+ * @param str The string to convert, e.g., "urxvt".
+ * @returns The quark representing the string or XCB_XRM_NULLQUARK if str is
+ * NULL or memory could not be allocated.
+ */
+xcb_xrm_quark_t xcb_xrm_string_to_quark(const char *str);
+
+/**
+ * Converts a fully qualified resource name or class into a list of quarks,
+ * one for each component. The list is terminated by XCB_XRM_NULLQUARK.
+ *
+ * Here is an example of how a toolkit can use this to efficiently look up a
+ * resource many times:
+ * @code
+ * xcb_xrm_quark_t names[3], classes[3];
+ * xcb_xrm_string_to_quark_list("urxvt.font", names, 3);
+ * xcb_xrm_string_to_quark_list("URxvt.Font", classes, 3);
+ *
+ * char *font = xcb_xrm_resource_get_string_q(database, names, classes);
+ * @endcode
+ *
+ * @param str The resource name or class, e.g., "urxvt.font".
+ * @param quarks The array to store the quarks in.
+ * @param size The number of elements quarks can hold, including the
+ * terminating XCB_XRM_NULLQUARK.
+ * @returns The number of components or a negative value if str is not a
+ * valid resource name or quarks is too small.
+ */
+int xcb_xrm_string_to_quark_list(const char *str, xcb_xrm_quark_t *quarks, size_t size);
+
+/**
+ * Returns the string represented by a quark.
+ * The string is owned by the library and must not be modified or free'd.
+ *
+ * @param quark The quark to convert.
+ * @returns The string represented by the quark or NULL if the quark is
+ * unknown.
+ */
+const char *xcb_xrm_quark_to_string(xcb_xrm_quark_t quark);
+
 /**
  * Converts a string value to a long.
  * If value is NULL or cannot be converted to a long, LONG_MIN is returned.
@@ -0,0 +1,145 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * Copyright © 2016 Ingo Bürk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the names of the authors or their
+ * institutions shall not be used in advertising or otherwise to promote the
+ * sale, use or other dealings in this Software without prior written
+ * authorization from the authors.
+ *
+ */
+#include "externals.h"
+
+#include "arena.h"
+#include "util.h"
+
+/* The size of the first chunk. Every new chunk doubles the size until
+ * ARENA_MAX_CHUNK_SIZE is reached. */
+#define ARENA_MIN_CHUNK_SIZE 4096
+#define ARENA_MAX_CHUNK_SIZE (256 * 1024)
+
+/* All allocations are aligned to this. */
+#define ARENA_ALIGNMENT (2 * sizeof(void *))
+#define ARENA_ALIGN(size) (((size) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+
+/* Forward declarations */
+static xcb_xrm_arena_chunk_t *__arena_new_chunk(xcb_xrm_arena_t *arena, size_t size);
+
+/*
+ * Allocates size bytes of zero-initialized memory from the arena.
+ *
+ * @return The allocated memory or NULL if memory could not be allocated.
+ *
+ */
+void *xcb_xrm_arena_alloc(xcb_xrm_arena_t *arena, size_t size) {
+    xcb_xrm_arena_chunk_t *chunk = arena->chunks;
+    void *result;
+
+    size = ARENA_ALIGN(size);
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        chunk = __arena_new_chunk(arena, size);
+        if (chunk == NULL)
+            return NULL;
+    }
+
+    result = chunk->data + chunk->used;
+    chunk->used += size;
+    return result;
+}
+
+/*
+ * Shrinks the most recent allocation of the arena to new_size bytes, giving
+ * the remaining bytes back to the arena. Nothing happens if ptr was not the
+ * most recent allocation.
+ *
+ */
+void xcb_xrm_arena_shrink(xcb_xrm_arena_t *arena, void *ptr, size_t size, size_t new_size) {
+    xcb_xrm_arena_chunk_t *chunk = arena->chunks;
+
+    size = ARENA_ALIGN(size);
+    new_size = ARENA_ALIGN(new_size);
+    if (chunk == NULL || (char *) ptr + size != chunk->data + chunk->used || new_size > size)
+        return;
+
+    /* Handed out memory must be zero-initialized. */
+    memset((char *) ptr + new_size, 0, size - new_size);
+    chunk->used -= size - new_size;
+}
+
+/*
+ * Moves all memory of the source arena into the target arena. The source
+ * arena is empty afterwards, but memory allocated from it stays valid until
+ * the target arena is freed.
+ *
+ */
+void xcb_xrm_arena_splice(xcb_xrm_arena_t *target, xcb_xrm_arena_t *source) {
+    xcb_xrm_arena_chunk_t *last = source->chunks;
+
+    if (last == NULL)
+        return;
+
+    /* Put the source chunks behind the current chunk of the target so that
+     * the target keeps allocating from its current chunk. */
+    while (last->next != NULL)
+        last = last->next;
+
+    if (target->chunks == NULL) {
+        target->chunks = source->chunks;
+    } else {
+        last->next = target->chunks->next;
+        target->chunks->next = source->chunks;
+    }
+
+    target->total_size += source->total_size;
+    source->chunks = NULL;
+    source->total_size = 0;
+}
+
+/*
+ * Frees all memory allocated from the arena.
+ *
+ */
+void xcb_xrm_arena_free(xcb_xrm_arena_t *arena) {
+    while (arena->chunks != NULL) {
+        xcb_xrm_arena_chunk_t *next = arena->chunks->next;
+        FREE(arena->chunks);
+        arena->chunks = next;
+    }
+
+    arena->total_size = 0;
+}
+
+static xcb_xrm_arena_chunk_t *__arena_new_chunk(xcb_xrm_arena_t *arena, size_t size) {
+    xcb_xrm_arena_chunk_t *chunk;
+    size_t chunk_size = arena->chunks == NULL ? ARENA_MIN_CHUNK_SIZE :
+        MIN(2 * arena->chunks->size, ARENA_MAX_CHUNK_SIZE);
+
+    chunk = calloc(1, ARENA_ALIGN(sizeof(xcb_xrm_arena_chunk_t)) + MAX(chunk_size, size));
+    if (chunk == NULL)
+        return NULL;
+
+    chunk->data = (char *) chunk + ARENA_ALIGN(sizeof(xcb_xrm_arena_chunk_t));
+    chunk->size = MAX(chunk_size, size);
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->total_size += chunk->size;
+    return chunk;
+}
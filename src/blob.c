@@ -0,0 +1,273 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * Copyright © 2016 Ingo Bürk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the names of the authors or their
+ * institutions shall not be used in advertising or otherwise to promote the
+ * sale, use or other dealings in this Software without prior written
+ * authorization from the authors.
+ *
+ */
+#include "externals.h"
+
+#include "blob.h"
+#include "util.h"
+
+/* The number of names whose quarks are remembered while reading a blob. */
+#define BLOB_QUARK_CACHE_SIZE 4096
+
+/* Remembers the quark of a name in the string pool. Every name is stored
+ * only once, so its offset identifies it. */
+typedef struct blob_quark_slot_t {
+    uint32_t name;
+    xcb_xrm_quark_t quark;
+    /* The name as owned by the quark table. */
+    const char *string;
+} blob_quark_slot_t;
+
+/* Forward declarations */
+static bool __blob_contains(size_t length, uint32_t offset, uint32_t count, size_t size);
+static int __blob_read_entry(xcb_xrm_database_t *database, const char *blob, const xcb_xrm_blob_header_t *header,
+        const xcb_xrm_blob_entry_t *blob_entry, blob_quark_slot_t *quarks);
+
+/*
+ * Serializes the entries of the database. The blob is allocated dynamically
+ * and must be free'd.
+ *
+ */
+int xcb_xrm_blob_write(xcb_xrm_database_t *database, void **blob, size_t *length) {
+    xcb_xrm_blob_header_t header = {
+        .magic = BLOB_MAGIC,
+        .version = BLOB_VERSION,
+    };
+    xcb_xrm_entry_t *entry;
+    /* The offset of every component name in the string pool, by quark. */
+    uint32_t *names = NULL;
+    xcb_xrm_quark_t max_quark = XCB_XRM_NULLQUARK;
+    size_t num_components = 0;
+    size_t num_entries = 0;
+    size_t strings_size = 0;
+    size_t total;
+    char *data;
+    xcb_xrm_blob_component_t *blob_component;
+    xcb_xrm_blob_entry_t *blob_entry;
+    char *strings;
+
+    /* Size all tables first. */
+    TAILQ_FOREACH(entry, &(database->entries), entries) {
+        for (int i = 0; i < entry->num_components; i++)
+            max_quark = MAX(max_quark, entry->components[i].quark);
+        num_components += entry->num_components;
+
+        strings_size += strlen(entry->value) + 1;
+        num_entries++;
+    }
+
+    names = malloc((max_quark + 1) * sizeof(uint32_t));
+    if (names == NULL)
+        return -FAILURE;
+    for (xcb_xrm_quark_t quark = 0; quark <= max_quark; quark++)
+        names[quark] = BLOB_NONE;
+
+    TAILQ_FOREACH(entry, &(database->entries), entries) {
+        for (int i = 0; i < entry->num_components; i++) {
+            xcb_xrm_component_t *component = &(entry->components[i]);
+            if (component->type != CT_NORMAL || names[component->quark] != BLOB_NONE)
+                continue;
+
+            names[component->quark] = strings_size;
+            strings_size += strlen(component->name) + 1;
+        }
+    }
+
+    header.components = sizeof(xcb_xrm_blob_header_t);
+    header.num_components = num_components;
+    header.entries = header.components + num_components * sizeof(xcb_xrm_blob_component_t);
+    header.num_entries = num_entries;
+    header.strings = header.entries + num_entries * sizeof(xcb_xrm_blob_entry_t);
+    header.strings_size = strings_size;
+
+    /* All offsets must fit into the header's fields. */
+    total = sizeof(xcb_xrm_blob_header_t) + num_components * sizeof(xcb_xrm_blob_component_t) +
+        num_entries * sizeof(xcb_xrm_blob_entry_t) + strings_size;
+    if (total >= BLOB_NONE || (data = calloc(1, total)) == NULL) {
+        FREE(names);
+        return -FAILURE;
+    }
+
+    memcpy(data, &header, sizeof(xcb_xrm_blob_header_t));
+    blob_component = (xcb_xrm_blob_component_t *)(data + header.components);
+    blob_entry = (xcb_xrm_blob_entry_t *)(data + header.entries);
+    strings = data + header.strings;
+
+    /* Values are stored first, so an entry's value is at the offset of the
+     * previous value plus its size. */
+    num_components = 0;
+    strings_size = 0;
+    TAILQ_FOREACH(entry, &(database->entries), entries) {
+        size_t value_size = strlen(entry->value) + 1;
+
+        blob_entry->value = strings_size;
+        blob_entry->first_component = num_components;
+        memcpy(strings + strings_size, entry->value, value_size);
+        strings_size += value_size;
+
+        for (int i = 0; i < entry->num_components; i++) {
+            xcb_xrm_component_t *component = &(entry->components[i]);
+
+            blob_component->binding_type = component->binding_type;
+            if (component->type == CT_NORMAL) {
+                blob_component->name = names[component->quark];
+                memcpy(strings + blob_component->name, component->name, strlen(component->name) + 1);
+            } else {
+                blob_component->name = BLOB_NONE;
+            }
+
+            blob_component++;
+            num_components++;
+        }
+
+        blob_entry->num_components = num_components - blob_entry->first_component;
+        blob_entry++;
+    }
+
+    FREE(names);
+    *blob = data;
+    *length = total;
+    return SUCCESS;
+}
+
+/*
+ * Inserts the entries of a serialized database into the database, which
+ * must be empty.
+ *
+ */
+int xcb_xrm_blob_read(xcb_xrm_database_t *database, const void *blob, size_t length) {
+    xcb_xrm_blob_header_t header;
+    blob_quark_slot_t *quarks;
+    int result = SUCCESS;
+
+    if (blob == NULL || length < sizeof(xcb_xrm_blob_header_t))
+        return -FAILURE;
+
+    /* The blob might not be aligned, so we copy everything we read. */
+    memcpy(&header, blob, sizeof(xcb_xrm_blob_header_t));
+    if (header.magic != BLOB_MAGIC || header.version != BLOB_VERSION)
+        return -FAILURE;
+
+    if (!__blob_contains(length, header.components, header.num_components, sizeof(xcb_xrm_blob_component_t)) ||
+        !__blob_contains(length, header.entries, header.num_entries, sizeof(xcb_xrm_blob_entry_t)) ||
+        !__blob_contains(length, header.strings, header.strings_size, 1))
+        return -FAILURE;
+
+    /* Every string in the pool must be terminated within the pool. */
+    if (header.strings_size > 0 && ((const char *)blob)[header.strings + header.strings_size - 1] != '\0')
+        return -FAILURE;
+
+    /* Most components share their names with many others, so interning
+     * every name only once makes up for most of the time spent here. */
+    quarks = calloc(BLOB_QUARK_CACHE_SIZE, sizeof(blob_quark_slot_t));
+    if (quarks == NULL)
+        return -FAILURE;
+
+    for (uint32_t i = 0; i < header.num_entries; i++) {
+        xcb_xrm_blob_entry_t blob_entry;
+
+        memcpy(&blob_entry, (const char *)blob + header.entries + i * sizeof(xcb_xrm_blob_entry_t),
+                sizeof(xcb_xrm_blob_entry_t));
+        if (__blob_read_entry(database, blob, &header, &blob_entry, quarks) < 0) {
+            result = -FAILURE;
+            break;
+        }
+    }
+
+    FREE(quarks);
+    return result;
+}
+
+/* Returns whether count elements of the given size starting at offset are
+ * within the blob. */
+static bool __blob_contains(size_t length, uint32_t offset, uint32_t count, size_t size) {
+    return offset <= length && count <= (length - offset) / size;
+}
+
+static int __blob_read_entry(xcb_xrm_database_t *database, const char *blob, const xcb_xrm_blob_header_t *header,
+        const xcb_xrm_blob_entry_t *blob_entry, blob_quark_slot_t *quarks) {
+    const char *strings = blob + header->strings;
+    xcb_xrm_entry_t *entry;
+    size_t value_size;
+
+    if (blob_entry->value >= header->strings_size || blob_entry->num_components == 0 ||
+        blob_entry->first_component > header->num_components ||
+        blob_entry->num_components > header->num_components - blob_entry->first_component)
+        return -FAILURE;
+
+    /* The blob might be unmapped as soon as it has been read, so the value is
+     * copied. */
+    value_size = strlen(strings + blob_entry->value) + 1;
+    entry = xcb_xrm_entry_new(&(database->arena), blob_entry->num_components, value_size);
+    if (entry == NULL)
+        return -FAILURE;
+    memcpy(entry->value, strings + blob_entry->value, value_size);
+
+    for (uint32_t i = 0; i < blob_entry->num_components; i++) {
+        xcb_xrm_blob_component_t blob_component;
+        xcb_xrm_component_t *component = &(entry->components[i]);
+
+        memcpy(&blob_component, blob + header->components +
+                (blob_entry->first_component + i) * sizeof(xcb_xrm_blob_component_t),
+                sizeof(xcb_xrm_blob_component_t));
+        if (blob_component.binding_type > BT_LOOSE ||
+            (blob_component.name != BLOB_NONE && blob_component.name >= header->strings_size))
+            return -FAILURE;
+
+        component->binding_type = blob_component.binding_type;
+        if (blob_component.name == BLOB_NONE) {
+            component->type = CT_WILDCARD;
+        } else {
+            blob_quark_slot_t *slot = &(quarks[blob_component.name % BLOB_QUARK_CACHE_SIZE]);
+
+            if (slot->quark == XCB_XRM_NULLQUARK || slot->name != blob_component.name) {
+                const char *name = strings + blob_component.name;
+                if (*name == '\0')
+                    return -FAILURE;
+
+                slot->name = blob_component.name;
+                slot->quark = xcb_xrm_quark_intern(name, strlen(name), &(slot->string));
+                if (slot->quark == XCB_XRM_NULLQUARK)
+                    return -FAILURE;
+            }
+
+            component->type = CT_NORMAL;
+            component->quark = slot->quark;
+            component->name = slot->string;
+        }
+    }
+
+    /* Like the parser, we do not accept entries ending in a wildcard. */
+    if (entry->components[entry->num_components - 1].type != CT_NORMAL)
+        return -FAILURE;
+
+    xcb_xrm_entry_update_hash(entry);
+
+    xcb_xrm_database_put(database, entry, true);
+    return SUCCESS;
+}
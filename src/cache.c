@@ -0,0 +1,156 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * Copyright © 2016 Ingo Bürk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the names of the authors or their
+ * institutions shall not be used in advertising or otherwise to promote the
+ * sale, use or other dealings in this Software without prior written
+ * authorization from the authors.
+ *
+ */
+#include "externals.h"
+
+#include "cache.h"
+#include "util.h"
+
+/* Forward declarations */
+static uint32_t __cache_hash(const char *res_name, size_t name_len, const char *res_class, size_t class_len);
+
+/*
+ * Changes the number of slots of the cache, dropping all cached results.
+ * The size is rounded up to a power of two. A size of zero disables the
+ * cache.
+ *
+ * @return 0 on success, a negative error code otherwise. On error, the cache
+ * is disabled.
+ *
+ */
+int xcb_xrm_cache_resize(xcb_xrm_cache_t *cache, size_t size) {
+    size_t new_size = 1;
+
+    xcb_xrm_cache_free(cache);
+    if (size == 0)
+        return SUCCESS;
+
+    while (new_size < size)
+        new_size *= 2;
+
+    cache->slots = calloc(new_size, sizeof(xcb_xrm_cache_slot_t));
+    if (cache->slots == NULL)
+        return -FAILURE;
+
+    cache->size = new_size;
+    return SUCCESS;
+}
+
+/*
+ * Looks up the result of the given query. Both res_name and res_class must
+ * not be NULL.
+ *
+ * @return true if the result is cached, in which case it is stored in entry.
+ *
+ */
+bool xcb_xrm_cache_lookup(xcb_xrm_cache_t *cache, unsigned long generation,
+        const char *res_name, const char *res_class, xcb_xrm_entry_t **entry) {
+    xcb_xrm_cache_slot_t *slot;
+    size_t name_len;
+    size_t class_len;
+    uint32_t hash;
+
+    if (cache->slots == NULL)
+        return false;
+
+    name_len = strlen(res_name);
+    class_len = strlen(res_class);
+    hash = __cache_hash(res_name, name_len, res_class, class_len);
+
+    slot = &(cache->slots[hash & (cache->size - 1)]);
+    if (slot->key == NULL || slot->generation != generation || slot->hash != hash ||
+            slot->name_len != name_len || slot->class_len != class_len ||
+            memcmp(slot->key, res_name, name_len) != 0 ||
+            memcmp(slot->key + name_len + 1, res_class, class_len) != 0) {
+        cache->misses++;
+        return false;
+    }
+
+    cache->hits++;
+    *entry = slot->entry;
+    return true;
+}
+
+/*
+ * Stores the result of the given query. Both res_name and res_class must not
+ * be NULL. entry may be NULL to remember that the query did not match.
+ *
+ */
+void xcb_xrm_cache_store(xcb_xrm_cache_t *cache, unsigned long generation,
+        const char *res_name, const char *res_class, xcb_xrm_entry_t *entry) {
+    xcb_xrm_cache_slot_t *slot;
+    size_t name_len;
+    size_t class_len;
+    uint32_t hash;
+    char *key;
+
+    if (cache->slots == NULL)
+        return;
+
+    name_len = strlen(res_name);
+    class_len = strlen(res_class);
+    hash = __cache_hash(res_name, name_len, res_class, class_len);
+    slot = &(cache->slots[hash & (cache->size - 1)]);
+
+    /* Reuse the slot's key if it's large enough. */
+    if (slot->key != NULL && slot->name_len + slot->class_len >= name_len + class_len) {
+        key = slot->key;
+    } else {
+        key = malloc(name_len + class_len + 2);
+        if (key == NULL)
+            return;
+
+        FREE(slot->key);
+    }
+
+    memcpy(key, res_name, name_len + 1);
+    memcpy(key + name_len + 1, res_class, class_len + 1);
+
+    slot->key = key;
+    slot->name_len = name_len;
+    slot->class_len = class_len;
+    slot->hash = hash;
+    slot->generation = generation;
+    slot->entry = entry;
+}
+
+/*
+ * Frees all memory used by the cache and disables it.
+ *
+ */
+void xcb_xrm_cache_free(xcb_xrm_cache_t *cache) {
+    for (size_t i = 0; i < cache->size; i++)
+        FREE(cache->slots[i].key);
+
+    FREE(cache->slots);
+    cache->size = 0;
+}
+
+static uint32_t __cache_hash(const char *res_name, size_t name_len, const char *res_class, size_t class_len) {
+    return hash_bytes(res_name, name_len) * 31 + hash_bytes(res_class, class_len);
+}
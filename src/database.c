@@ -29,11 +29,134 @@
 #include "externals.h"
 
 #include "database.h"
+#include "blob.h"
 #include "match.h"
 #include "util.h"
 
+/* The number of 32-bit units of the RESOURCE_MANAGER property which are
+ * requested at first. */
+#define RESOURCE_MANAGER_REQUEST_LENGTH (16 * 1024)
+
+/* The size of the buffer for the name of a shared memory snapshot. */
+#define SHARED_NAME_SIZE 64
+
+/* The number of seconds after which a snapshot which has not been completed
+ * is considered abandoned by its publisher. */
+#define SHARED_STALE_SECONDS 10
+
+/* The size of the chunks passed to the writer by xcb_xrm_database_write. */
+#define WRITE_BUFFER_SIZE 4096
+
+/* The minimum amount of input parsed by a task of the parallel parser. */
+#define PARALLEL_MIN_CHUNK_SIZE (64 * 1024)
+
+/* A file which has been included while loading a database. Files are
+ * identified like this so that different paths to the same file are
+ * recognized, but a file which changed in between is read again. */
+typedef struct database_include_t {
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    /* The database parsed from the file or NULL while it is still being
+     * loaded. */
+    xcb_xrm_database_t *database;
+} database_include_t;
+
+/* The files included while loading a database. Every file is only parsed
+ * once, and including a file which is still being loaded, i.e., which
+ * directly or indirectly includes itself, is ignored. */
+typedef struct database_load_t {
+    database_include_t *includes;
+    size_t num_includes;
+    size_t size_includes;
+} database_load_t;
+
+/* A part of the input of the parallel parser and the database parsed from
+ * it. */
+typedef struct database_task_t {
+    const char *str;
+    size_t len;
+    xcb_xrm_database_t *database;
+} database_task_t;
+
+/* The tasks of the parallel parser. Every thread takes the next task which
+ * has not been taken yet until all are done. */
+typedef struct database_pool_t {
+    database_task_t *tasks;
+    size_t num_tasks;
+    size_t size_tasks;
+    size_t next_task;
+    /* The files which are being loaded by the caller. Every task starts out
+     * with its own copy. */
+    database_load_t *load;
+} database_pool_t;
+
+/* A file which is loaded by __database_from_default on a thread of its own
+ * while the RESOURCE_MANAGER property is being fetched. */
+typedef struct database_default_file_t {
+    /* The file or NULL if there is nothing to load. */
+    char *filename;
+    xcb_xrm_database_t *database;
+    pthread_t thread;
+    bool started;
+} database_default_file_t;
+
+/* The databases being combined by __database_merge. */
+typedef struct database_merge_t {
+    xcb_xrm_database_t *target;
+    xcb_xrm_database_t *source;
+    bool override;
+} database_merge_t;
+
+/* The string built by xcb_xrm_database_to_string. */
+typedef struct database_string_t {
+    char *data;
+    size_t length;
+    size_t size;
+} database_string_t;
+
 /* Forward declarations */
-void xcb_xrm_database_put(xcb_xrm_database_t *database, xcb_xrm_entry_t *entry, bool override);
+static xcb_xrm_database_t *__database_new(void);
+static int __database_append_string(void *data, const char *buffer, size_t length);
+static xcb_xrm_database_t *__database_from_default(xcb_connection_t *conn, bool shared);
+static void __database_start_file(database_default_file_t *file, char *filename);
+static xcb_xrm_database_t *__database_finish_file(database_default_file_t *file);
+static void *__database_load_default_file(void *data);
+static xcb_xrm_database_t *__database_from_resource_manager_shared(xcb_connection_t *conn,
+        xcb_xrm_resource_manager_cookie_t cookie);
+static uint64_t __database_shared_display(xcb_window_t root);
+static void __database_shared_name(char *name, uint64_t display, uint64_t hash);
+static void __database_current_name(char *name, uint64_t display);
+static xcb_xrm_database_t *__database_from_shared(const char *name);
+static void __database_share(xcb_xrm_database_t *database, uint64_t display, uint64_t hash);
+static void __database_set_current(uint64_t display, uint64_t hash);
+static xcb_xrm_database_t *__database_from_resource_manager(xcb_connection_t *conn,
+        xcb_xrm_resource_manager_cookie_t cookie, bool lazy);
+static xcb_xrm_database_t *__database_from_string(const char *str, bool lazy);
+static xcb_xrm_database_t *__database_from_buffer(const char *str, size_t len, database_load_t *load, bool lazy);
+static xcb_xrm_database_t *__database_from_buffer_parallel(const char *str, size_t len, int num_threads,
+        database_load_t *load);
+static xcb_xrm_database_t *__database_load_file(const char *filename, int num_threads, database_load_t *load);
+static void __database_include(xcb_xrm_database_t *database, const char *filename, database_load_t *load);
+static database_include_t *__database_add_include(database_load_t *load, const struct stat *stbuf);
+static void __database_load_free(database_load_t *load);
+static int __database_split(database_pool_t *pool, const char *str, size_t len, size_t chunk_size);
+static int __database_add_task(database_pool_t *pool, const char *str, size_t len);
+static bool __database_is_include(const char *line, const char *end);
+static void *__database_run_tasks(void *data);
+static void __database_put_line(xcb_xrm_database_t *database, const char *line, size_t len);
+static bool __database_defer_line(xcb_xrm_database_t *database, const char *line, size_t len);
+static void __database_insert(xcb_xrm_database_t *database, xcb_xrm_entry_t *entry, unsigned long position);
+static void __database_load_all(xcb_xrm_database_t *database);
+static int __database_compare_positions(const void *first, const void *second);
+static void __database_publish(xcb_xrm_database_t *database);
+static void __database_free_retired(xcb_xrm_database_t *database);
+static void __database_invalidate(xcb_xrm_database_t *database);
+static void __database_remove(xcb_xrm_database_t *database, xcb_xrm_entry_t *entry);
+static int __database_compact(xcb_xrm_database_t *database);
+static int __database_merge(xcb_xrm_database_t *target, xcb_xrm_database_t *source, bool override);
+static void __database_discard(xcb_xrm_entry_t *entry, void *data);
+static int __database_add_change(char ***changed_keys, size_t *num_changed, xcb_xrm_entry_t *entry);
 
 /*
  * Creates a database similarly to XGetDefault(). For typical applications,
@@ -59,63 +182,128 @@ void xcb_xrm_database_put(xcb_xrm_database_t *database, xcb_xrm_entry_t *entry,
  * part, but is not exactly the same. In particular, XGetDefault() does not
  * consider $HOME/.Xresources.
  *
+ * The files are loaded on threads of their own while the property is being
+ * fetched.
+ *
  * @param conn XCB connection.
  * @returns The constructed database. Can return NULL, e.g., if the screen
  * cannot be determined.
  */
 xcb_xrm_database_t *xcb_xrm_database_from_default(xcb_connection_t *conn) {
+    return __database_from_default(conn, false);
+}
+
+/*
+ * Creates a database like @ref xcb_xrm_database_from_default, but loads the
+ * RESOURCE_MANAGER property with @ref
+ * xcb_xrm_database_from_resource_manager_shared.
+ *
+ * @param conn XCB connection.
+ * @returns The constructed database. Can return NULL, e.g., if the screen
+ * cannot be determined.
+ */
+xcb_xrm_database_t *xcb_xrm_database_from_default_shared(xcb_connection_t *conn) {
+    return __database_from_default(conn, true);
+}
+
+/* Loads the files while waiting for the RESOURCE_MANAGER property. The
+ * databases are then picked and combined as described above, so the result is
+ * the same as loading them one after the other. */
+static xcb_xrm_database_t *__database_from_default(xcb_connection_t *conn, bool shared) {
+    xcb_xrm_resource_manager_cookie_t cookie;
+    database_default_file_t files[3];
     xcb_screen_t *screen;
     xcb_xrm_database_t *database;
+    xcb_xrm_database_t *xresources;
+    xcb_xrm_database_t *xdefaults;
+    xcb_xrm_database_t *source;
     char *xenvironment;
+    bool combine = true;
 
     screen = xcb_aux_get_screen(conn, 0);
     if (screen == NULL)
         return NULL;
 
-    /* 1. Try to load the database from RESOURCE_MANAGER. */
-    database = xcb_xrm_database_from_resource_manager(conn, screen);
+    /* 1. Request the RESOURCE_MANAGER property and make sure the request is
+     *    sent before we start reading files. */
+    cookie = xcb_xrm_database_from_resource_manager_request(conn, screen);
+    xcb_flush(conn);
 
-    /* 2. Otherwise, try to load the database from $HOME/.Xresources. */
-    if (database == NULL) {
-        char *xresources = get_home_dir_file(".Xresources");
-        database = xcb_xrm_database_from_file(xresources);
-        FREE(xresources);
-    }
-
-    /* 3. Otherwise, try to load the database from $HOME/.Xdefaults. */
-    if (database == NULL) {
-        char *xdefaults = get_home_dir_file(".Xdefaults");
-        database = xcb_xrm_database_from_file(xdefaults);
-        FREE(xdefaults);
-    }
+    /* 2. and 3. In case the property does not exist, load $HOME/.Xresources
+     *    and $HOME/.Xdefaults. */
+    __database_start_file(&files[0], get_home_dir_file(".Xresources"));
+    __database_start_file(&files[1], get_home_dir_file(".Xdefaults"));
 
-    /* 4. If XENVIRONMENT is specified, merge the database defined by that file.
+    /* 4. If XENVIRONMENT is specified, load the database defined by that file.
      *    Otherwise, use $HOME/.Xdefaults-$HOSTNAME. */
     if ((xenvironment = getenv("XENVIRONMENT")) != NULL) {
-        xcb_xrm_database_t *source = xcb_xrm_database_from_file(xenvironment);
-        xcb_xrm_database_combine(source, &database, true);
+        __database_start_file(&files[2], strdup(xenvironment));
     } else {
         char hostname[1024];
+        char *name = NULL;
+
         hostname[1023] = '\0';
-        if (gethostname(hostname, 1023) == 0) {
-            char *name;
-            if (asprintf(&name, ".Xdefaults-%s", hostname) >= 0) {
-                xcb_xrm_database_t *source;
+        combine = gethostname(hostname, 1023) == 0 && asprintf(&name, ".Xdefaults-%s", hostname) >= 0;
+        __database_start_file(&files[2], combine ? get_home_dir_file(name) : NULL);
+        if (combine)
+            FREE(name);
+    }
 
-                char *xdefaults = get_home_dir_file(name);
-                FREE(name);
+    if (shared)
+        database = __database_from_resource_manager_shared(conn, cookie);
+    else
+        database = xcb_xrm_database_from_resource_manager_reply(conn, cookie);
 
-                source = xcb_xrm_database_from_file(xdefaults);
-                FREE(xdefaults);
+    /* The files are only used if all databases before them are missing. */
+    xresources = __database_finish_file(&files[0]);
+    xdefaults = __database_finish_file(&files[1]);
+    source = __database_finish_file(&files[2]);
 
-                xcb_xrm_database_combine(source, &database, true);
-            }
-        }
+    if (database == NULL) {
+        database = xresources;
+        xresources = NULL;
+    }
+    if (database == NULL) {
+        database = xdefaults;
+        xdefaults = NULL;
     }
+    xcb_xrm_database_free(xresources);
+    xcb_xrm_database_free(xdefaults);
+
+    if (combine)
+        xcb_xrm_database_combine(source, &database, true);
 
     return database;
 }
 
+/* Starts loading the given file on a thread of its own. The file name is
+ * free'd once the file has been loaded. */
+static void __database_start_file(database_default_file_t *file, char *filename) {
+    file->filename = filename;
+    file->database = NULL;
+    file->started = filename != NULL &&
+        pthread_create(&(file->thread), NULL, __database_load_default_file, file) == 0;
+}
+
+/* Waits until the file has been loaded and returns its database. If the
+ * thread could not be started, the file is loaded right away. */
+static xcb_xrm_database_t *__database_finish_file(database_default_file_t *file) {
+    if (file->started)
+        pthread_join(file->thread, NULL);
+    else if (file->filename != NULL)
+        __database_load_default_file(file);
+
+    FREE(file->filename);
+    return file->database;
+}
+
+static void *__database_load_default_file(void *data) {
+    database_default_file_t *file = data;
+
+    file->database = xcb_xrm_database_from_file(file->filename);
+    return NULL;
+}
+
 /*
  * Loads the RESOURCE_MANAGER property and creates a database with its
  * contents. If the database could not be created, this function will return
@@ -128,124 +316,210 @@ xcb_xrm_database_t *xcb_xrm_database_from_default(xcb_connection_t *conn) {
  * @ingroup xcb_xrm_database_t
  */
 xcb_xrm_database_t *xcb_xrm_database_from_resource_manager(xcb_connection_t *conn, xcb_screen_t *screen) {
+    return xcb_xrm_database_from_resource_manager_reply(conn,
+            xcb_xrm_database_from_resource_manager_request(conn, screen));
+}
+
+/*
+ * Sends the request for the RESOURCE_MANAGER property without waiting for
+ * the reply. The database can then be created by passing the returned cookie
+ * to @ref xcb_xrm_database_from_resource_manager_reply.
+ *
+ * @param conn A working XCB connection.
+ * @param screen The xcb_screen_t* screen to use.
+ * @returns The cookie for the request.
+ *
+ * @ingroup xcb_xrm_database_t
+ */
+xcb_xrm_resource_manager_cookie_t xcb_xrm_database_from_resource_manager_request(xcb_connection_t *conn,
+        xcb_screen_t *screen) {
+    xcb_xrm_resource_manager_cookie_t cookie = {
+        .cookie = xcb_util_get_property_request(conn, screen->root, XCB_ATOM_RESOURCE_MANAGER,
+                XCB_ATOM_STRING, RESOURCE_MANAGER_REQUEST_LENGTH),
+        .window = screen->root,
+    };
+
+    return cookie;
+}
+
+/*
+ * Waits for the reply to the request sent by @ref
+ * xcb_xrm_database_from_resource_manager_request and creates a database with
+ * the contents of the RESOURCE_MANAGER property. If the database could not be
+ * created, this function will return NULL.
+ *
+ * @param conn The XCB connection the request was sent on.
+ * @param cookie The cookie returned for the request.
+ * @returns The database described by the RESOURCE_MANAGER property.
+ *
+ * @ingroup xcb_xrm_database_t
+ */
+xcb_xrm_database_t *xcb_xrm_database_from_resource_manager_reply(xcb_connection_t *conn,
+        xcb_xrm_resource_manager_cookie_t cookie) {
+    return __database_from_resource_manager(conn, cookie, false);
+}
+
+static xcb_xrm_database_t *__database_from_resource_manager(xcb_connection_t *conn,
+        xcb_xrm_resource_manager_cookie_t cookie, bool lazy) {
     xcb_xrm_database_t *database;
+    uint64_t start = get_time();
 
-    char *resources = xcb_util_get_property(conn, screen->root, XCB_ATOM_RESOURCE_MANAGER,
-            XCB_ATOM_STRING, 16 * 1024);
+    char *resources = xcb_util_get_property_reply(conn, cookie.cookie, cookie.window, XCB_ATOM_RESOURCE_MANAGER,
+            XCB_ATOM_STRING);
+    uint64_t fetch_time = get_time() - start;
     if (resources == NULL) {
         return NULL;
     }
 
     /* Parse the resource string. */
-    database = xcb_xrm_database_from_string(resources);
+    database = __database_from_string(resources, lazy);
     FREE(resources);
+
+    if (database != NULL)
+        database->stats.fetch_time = fetch_time;
     return database;
 }
 
 /*
- * Creates a database from the given string.
- * If the database could not be created, this function will return NULL.
+ * Loads the RESOURCE_MANAGER property like @ref
+ * xcb_xrm_database_from_resource_manager, but shares the parsed database with
+ * other clients of the same user through POSIX shared memory.
  *
- * @param str The resource string.
- * @returns The database described by the resource string.
+ * The snapshot is identified by the display and a hash of the property's
+ * contents. If one exists, the database is loaded from it as with @ref
+ * xcb_xrm_database_from_blob. Otherwise, the property is parsed and a
+ * snapshot is published for the clients started after this one, replacing
+ * the previous snapshot of the display.
+ *
+ * @param conn A working XCB connection.
+ * @param screen The xcb_screen_t* screen to use.
+ * @returns The database described by the RESOURCE_MANAGER property.
  *
  * @ingroup xcb_xrm_database_t
  */
-xcb_xrm_database_t *xcb_xrm_database_from_string(const char *_str) {
-    xcb_xrm_database_t *database;
-    char *str;
-    int num_continuations = 0;
-    char *str_continued;
-    char *outwalk;
-    char *saveptr = NULL;
-
-    str = strdup(_str);
-    if (str == NULL)
-        return NULL;
-
-    /* Count the number of line continuations. */
-    for (char *walk = str; *walk != '\0'; walk++) {
-        if (*walk == '\\' && *(walk + 1) == '\n') {
-            num_continuations++;
-        }
-    }
+xcb_xrm_database_t *xcb_xrm_database_from_resource_manager_shared(xcb_connection_t *conn, xcb_screen_t *screen) {
+    return __database_from_resource_manager_shared(conn, xcb_xrm_database_from_resource_manager_request(conn, screen));
+}
 
-    /* Take care of line continuations. */
-    str_continued = calloc(1, strlen(str) + 1 - 2 * num_continuations);
-    if (str_continued == NULL) {
-        FREE(str);
+static xcb_xrm_database_t *__database_from_resource_manager_shared(xcb_connection_t *conn,
+        xcb_xrm_resource_manager_cookie_t cookie) {
+    xcb_xrm_database_t *database;
+    char name[SHARED_NAME_SIZE];
+    uint64_t start = get_time();
+    uint64_t fetch_time;
+    uint64_t display;
+    uint64_t hash;
+
+    char *resources = xcb_util_get_property_reply(conn, cookie.cookie, cookie.window, XCB_ATOM_RESOURCE_MANAGER,
+            XCB_ATOM_STRING);
+    fetch_time = get_time() - start;
+    if (resources == NULL)
         return NULL;
-    }
-
-    outwalk = str_continued;
-    for (char *walk = str; *walk != '\0'; walk++) {
-        if (*walk == '\\' && *(walk + 1) == '\n') {
-            walk++;
-            continue;
-        }
-
-        *(outwalk++) = *walk;
-    }
-    *outwalk = '\0';
 
-    database = calloc(1, sizeof(struct xcb_xrm_database_t));
+    display = __database_shared_display(cookie.window);
+    hash = hash_bytes_64(resources, strlen(resources));
+    __database_shared_name(name, display, hash);
+    database = __database_from_shared(name);
     if (database == NULL) {
-        FREE(str);
-        FREE(str_continued);
-        return NULL;
+        database = xcb_xrm_database_from_string(resources);
+        if (database != NULL)
+            __database_share(database, display, hash);
     }
+    FREE(resources);
 
-    TAILQ_INIT(database);
-
-    for (char *line = strtok_r(str_continued, "\n", &saveptr); line != NULL; line = strtok_r(NULL, "\n", &saveptr)) {
-        /* Handle include directives. */
-        if (line[0] == '#') {
-            int i = 1;
+    if (database != NULL)
+        database->stats.fetch_time = fetch_time;
+    return database;
+}
 
-            /* Skip whitespace and quotes. */
-            while (line[i] == ' ' || line[i] == '\t')
-                i++;
+/*
+ * Loads the RESOURCE_MANAGER property like @ref
+ * xcb_xrm_database_from_resource_manager, but parses it lazily like @ref
+ * xcb_xrm_database_from_string_lazy.
+ *
+ * @param conn A working XCB connection.
+ * @param screen The xcb_screen_t* screen to use.
+ * @returns The database described by the RESOURCE_MANAGER property.
+ *
+ * @ingroup xcb_xrm_database_t
+ */
+xcb_xrm_database_t *xcb_xrm_database_from_resource_manager_lazy(xcb_connection_t *conn, xcb_screen_t *screen) {
+    return __database_from_resource_manager(conn, xcb_xrm_database_from_resource_manager_request(conn, screen),
+            true);
+}
 
-            if (true &&
-                    line[i++] == 'i' &&
-                    line[i++] == 'n' &&
-                    line[i++] == 'c' &&
-                    line[i++] == 'l' &&
-                    line[i++] == 'u' &&
-                    line[i++] == 'd' &&
-                    line[i++] == 'e') {
-                xcb_xrm_database_t *included;
-                char *filename;
-                int j = strlen(line) - 1;
+/*
+ * Loads the RESOURCE_MANAGER property again and updates the database to match
+ * it, e.g., after receiving a PropertyNotify event for the property.
+ *
+ * @param database The database to update.
+ * @param conn A working XCB connection.
+ * @param screen The xcb_screen_t* screen to use.
+ * @param changed_keys If not NULL, returns a NULL-terminated list of the
+ * resource specifiers which have been inserted, removed or changed, e.g.,
+ * "*foreground". The list and each of its elements must be free'd. If nothing
+ * changed, NULL is returned.
+ * @returns The number of changed resource specifiers or a negative number on
+ * error.
+ *
+ * @ingroup xcb_xrm_database_t
+ */
+int xcb_xrm_database_update_from_resource_manager(xcb_xrm_database_t *database, xcb_connection_t *conn,
+        xcb_screen_t *screen, char ***changed_keys) {
+    xcb_xrm_database_t *source;
+    int result;
 
-                /* Skip whitespace and quotes. */
-                while (line[i] == ' ' || line[i] == '\t' || line[i] == '"')
-                    i++;
-                while (line[j] == ' ' || line[j] == '\t' || line[j] == '"')
-                    j--;
+    if (changed_keys != NULL)
+        *changed_keys = NULL;
+    if (database == NULL)
+        return -FAILURE;
 
-                if (j < i) {
-                    /* Only whitespace left in this line. */
-                    continue;
-                }
+    /* If the property does not exist anymore, all resources have been
+     * removed. */
+    source = xcb_xrm_database_from_resource_manager(conn, screen);
+    if (source == NULL && (source = xcb_xrm_database_from_string("")) == NULL)
+        return -FAILURE;
 
-                filename = &line[i];
-                line[j+i] = '\0';
+    database->stats.fetch_time += source->stats.fetch_time;
+    database->stats.parse_time += source->stats.parse_time;
 
-                included = xcb_xrm_database_from_file(filename);
+    result = xcb_xrm_database_update(database, source, changed_keys);
+    xcb_xrm_database_free(source);
+    return result;
+}
 
-                if (included != NULL)
-                    xcb_xrm_database_combine(included, &database, true);
+/*
+ * Creates a database from the given string.
+ * If the database could not be created, this function will return NULL.
+ *
+ * @param str The resource string.
+ * @returns The database described by the resource string.
+ *
+ * @ingroup xcb_xrm_database_t
+ */
+xcb_xrm_database_t *xcb_xrm_database_from_string(const char *str) {
+    return __database_from_string(str, false);
+}
 
-                continue;
-            }
-        }
+/*
+ * Creates a database from the given string like @ref
+ * xcb_xrm_database_from_string, but defers parsing most of its lines until a
+ * query might match them.
+ *
+ * @param str The resource string.
+ * @returns The database described by the resource string.
+ *
+ * @ingroup xcb_xrm_database_t
+ */
+xcb_xrm_database_t *xcb_xrm_database_from_string_lazy(const char *str) {
+    return __database_from_string(str, true);
+}
 
-        xcb_xrm_database_put_resource_line(&database, line);
-    }
+static xcb_xrm_database_t *__database_from_string(const char *str, bool lazy) {
+    database_load_t load = { NULL, 0, 0 };
+    xcb_xrm_database_t *database = __database_from_buffer(str, strlen(str), &load, lazy);
 
-    FREE(str);
-    FREE(str_continued);
+    __database_load_free(&load);
     return database;
 }
 
@@ -257,19 +531,46 @@ xcb_xrm_database_t *xcb_xrm_database_from_string(const char *_str) {
  * @returns The database described by the file's contents.
  */
 xcb_xrm_database_t *xcb_xrm_database_from_file(const char *filename) {
-    xcb_xrm_database_t *database;
-    char *content;
+    database_load_t load = { NULL, 0, 0 };
+    xcb_xrm_database_t *database = __database_load_file(filename, 1, &load);
 
-    if (filename == NULL)
-        return NULL;
+    __database_load_free(&load);
+    return database;
+}
 
-    content = file_get_contents(filename);
-    if (content == NULL)
-        return NULL;
+/*
+ * Creates a database from the given string like @ref
+ * xcb_xrm_database_from_string, but parses it on several threads.
+ *
+ * @param str The resource string.
+ * @param num_threads The maximum number of threads to use, including the
+ * calling thread. If zero or negative, one thread per online processor is
+ * used.
+ * @returns The database described by the resource string.
+ */
+xcb_xrm_database_t *xcb_xrm_database_from_string_parallel(const char *str, int num_threads) {
+    database_load_t load = { NULL, 0, 0 };
+    xcb_xrm_database_t *database = __database_from_buffer_parallel(str, strlen(str), num_threads, &load);
+
+    __database_load_free(&load);
+    return database;
+}
 
-    database = xcb_xrm_database_from_string(content);
-    FREE(content);
+/*
+ * Creates a database from a given file like @ref xcb_xrm_database_from_file,
+ * but parses it on several threads.
+ *
+ * @param filename Valid filename.
+ * @param num_threads The maximum number of threads to use, including the
+ * calling thread. If zero or negative, one thread per online processor is
+ * used.
+ * @returns The database described by the file's contents.
+ */
+xcb_xrm_database_t *xcb_xrm_database_from_file_parallel(const char *filename, int num_threads) {
+    database_load_t load = { NULL, 0, 0 };
+    xcb_xrm_database_t *database = __database_load_file(filename, num_threads, &load);
 
+    __database_load_free(&load);
     return database;
 }
 
@@ -281,25 +582,153 @@ xcb_xrm_database_t *xcb_xrm_database_from_file(const char *filename) {
  * @returns A string representation of the specified database.
  */
 char *xcb_xrm_database_to_string(xcb_xrm_database_t *database) {
-    char *result = NULL;
+    database_string_t str = { NULL, 0, 0 };
+
+    if (xcb_xrm_database_write(database, __database_append_string, &str) < 0) {
+        FREE(str.data);
+        return NULL;
+    }
 
+    return str.data;
+}
+
+/*
+ * Writes the string representation of a database, as returned by @ref
+ * xcb_xrm_database_to_string, by passing it to writer in chunks.
+ *
+ * @param database The database to write.
+ * @param writer Called with consecutive chunks of the string representation.
+ * @param data Passed to writer.
+ * @returns 0 on success, a negative error code otherwise.
+ */
+int xcb_xrm_database_write(xcb_xrm_database_t *database, xcb_xrm_writer_t writer, void *data) {
     xcb_xrm_entry_t *entry;
-    TAILQ_FOREACH(entry, database, entries) {
-        char *entry_str = xcb_xrm_entry_to_string(entry);
-        char *tmp;
-        if (asprintf(&tmp, "%s%s\n", result == NULL ? "" : result, entry_str) < 0) {
-            FREE(entry_str);
-            FREE(result);
-            return NULL;
+    char *buffer;
+    size_t size = WRITE_BUFFER_SIZE;
+    size_t length = 0;
+    int result = SUCCESS;
+
+    if (database == NULL || writer == NULL)
+        return -FAILURE;
+
+    buffer = malloc(size);
+    if (buffer == NULL)
+        return -FAILURE;
+
+    xcb_xrm_database_lock(database);
+    __database_load_all(database);
+
+    TAILQ_FOREACH(entry, &(database->entries), entries) {
+        size_t entry_length = xcb_xrm_entry_format(entry, NULL, true) + 1;
+
+        if (length + entry_length > size && length > 0) {
+            if ((result = writer(data, buffer, length)) < 0)
+                break;
+            length = 0;
+        }
+
+        /* The buffer only grows for entries which do not fit into it on
+         * their own. */
+        if (entry_length > size) {
+            char *new_buffer = realloc(buffer, entry_length);
+            if (new_buffer == NULL) {
+                result = -FAILURE;
+                break;
+            }
+
+            buffer = new_buffer;
+            size = entry_length;
         }
-        FREE(entry_str);
-        FREE(result);
-        result = tmp;
+
+        xcb_xrm_entry_format(entry, buffer + length, true);
+        length += entry_length;
+        buffer[length - 1] = '\n';
     }
 
+    if (result >= 0 && length > 0)
+        result = writer(data, buffer, length);
+
+    xcb_xrm_database_unlock(database);
+    FREE(buffer);
+
+    return result < 0 ? -FAILURE : SUCCESS;
+}
+
+/*
+ * Serializes the database into a compact binary format which can be loaded
+ * with @ref xcb_xrm_database_from_blob without parsing the string
+ * representation. Blobs can only be loaded on machines with the same byte
+ * order.
+ *
+ * @param database The database to serialize.
+ * @param blob Returns the serialized database, which must be free'd.
+ * @param length Returns the size of the blob in bytes.
+ * @returns 0 on success, a negative error code otherwise.
+ */
+int xcb_xrm_database_serialize(xcb_xrm_database_t *database, void **blob, size_t *length) {
+    int result;
+
+    if (database == NULL || blob == NULL || length == NULL)
+        return -FAILURE;
+
+    xcb_xrm_database_lock(database);
+    __database_load_all(database);
+    result = xcb_xrm_blob_write(database, blob, length);
+    xcb_xrm_database_unlock(database);
+
     return result;
 }
 
+/*
+ * Creates a database from a blob created by @ref xcb_xrm_database_serialize.
+ * The database does not refer to the blob, which can be free'd immediately.
+ * The database is frozen (see @ref xcb_xrm_database_freeze).
+ *
+ * @param blob The serialized database.
+ * @param length The size of the blob in bytes.
+ * @returns The database or NULL if the blob is not valid.
+ */
+xcb_xrm_database_t *xcb_xrm_database_from_blob(const void *blob, size_t length) {
+    uint64_t start = get_time();
+    xcb_xrm_database_t *database = __database_new();
+    if (database == NULL)
+        return NULL;
+
+    if (xcb_xrm_blob_read(database, blob, length) < 0) {
+        xcb_xrm_database_free(database);
+        return NULL;
+    }
+
+    /* If this fails, queries simply use the regular index. */
+    xcb_xrm_database_freeze(database);
+    database->stats.parse_time = get_time() - start;
+    return database;
+}
+
+/*
+ * Creates a database from a file containing a blob created by @ref
+ * xcb_xrm_database_serialize. The file is mapped rather than read.
+ *
+ * @param filename Valid filename.
+ * @returns The database or NULL if the file cannot be read or does not
+ * contain a valid blob.
+ */
+xcb_xrm_database_t *xcb_xrm_database_from_blob_file(const char *filename) {
+    xcb_xrm_database_t *database;
+    file_contents_t contents;
+
+    if (filename == NULL)
+        return NULL;
+
+    if (file_map_contents(filename, &contents) < 0)
+        return NULL;
+
+    database = xcb_xrm_database_from_blob(contents.data, contents.length);
+    file_unmap_contents(&contents);
+
+    return database;
+}
+
 /*
  * Combines two databases.
  * The entries from the source database are stored in the target database. If
@@ -321,12 +750,25 @@ void xcb_xrm_database_combine(xcb_xrm_database_t *source_db, xcb_xrm_database_t
     if (source_db == NULL)
         return;
 
-    while (!TAILQ_EMPTY(source_db)) {
-        xcb_xrm_entry_t *entry = TAILQ_FIRST(source_db);
-        TAILQ_REMOVE(source_db, entry, entries);
-        xcb_xrm_database_put(*target_db, entry, override);
+    xcb_xrm_database_lock(*target_db);
+    __database_load_all(*target_db);
+    __database_load_all(source_db);
+
+    /* The entries are moved, so the target now owns their memory. */
+    xcb_xrm_arena_splice(&((*target_db)->arena), &(source_db->arena));
+    (*target_db)->num_discarded += source_db->num_discarded;
+
+    /* Instead of inserting every entry on its own, we merge the indexes. If
+     * that fails, nothing has been merged yet. */
+    if (__database_merge(*target_db, source_db, override) < 0) {
+        while (!TAILQ_EMPTY(&(source_db->entries))) {
+            xcb_xrm_entry_t *entry = TAILQ_FIRST(&(source_db->entries));
+            TAILQ_REMOVE(&(source_db->entries), entry, entries);
+            xcb_xrm_database_put(*target_db, entry, override);
+        }
     }
 
+    xcb_xrm_database_unlock(*target_db);
     xcb_xrm_database_free(source_db);
 }
 
@@ -377,23 +819,14 @@ void xcb_xrm_database_put_resource(xcb_xrm_database_t **database, const char *re
  * @param line The complete resource specification to insert.
  */
 void xcb_xrm_database_put_resource_line(xcb_xrm_database_t **database, const char *line) {
-    xcb_xrm_entry_t *entry;
-
     assert(line != NULL);
 
     if (*database == NULL)
         *database = xcb_xrm_database_from_string("");
 
-    /* Ignore comments and directives. The specification guarantees that no
-     * whitespace is allowed before these characters. */
-    if (line[0] == '!' || line[0] == '#')
-        return;
-
-    if (xcb_xrm_entry_parse(line, &entry, false) == 0) {
-        xcb_xrm_database_put(*database, entry, true);
-    } else {
-        xcb_xrm_entry_free(entry);
-    }
+    xcb_xrm_database_lock(*database);
+    __database_put_line(*database, line, strlen(line));
+    xcb_xrm_database_unlock(*database);
 }
 
 /**
@@ -407,44 +840,1186 @@ void xcb_xrm_database_free(xcb_xrm_database_t *database) {
     if (database == NULL)
         return;
 
-    while (!TAILQ_EMPTY(database)) {
-        xcb_xrm_entry_t *entry = TAILQ_FIRST(database);
-        TAILQ_REMOVE(database, entry, entries);
-        xcb_xrm_entry_free(entry);
-    }
-
+    xcb_xrm_node_free(database->root);
+    xcb_xrm_frozen_free(database->frozen);
+    xcb_xrm_lazy_free(database->lazy);
+    __database_free_retired(database);
+    if (database->concurrent)
+        pthread_mutex_destroy(&(database->mutex));
+    xcb_xrm_arena_free(&(database->arena));
+    xcb_xrm_cache_free(&(database->cache));
     FREE(database);
 }
 
-void xcb_xrm_database_put(xcb_xrm_database_t *database, xcb_xrm_entry_t *entry, bool override) {
-    xcb_xrm_entry_t *current;
+/*
+ * Enables a cache for the results of @ref xcb_xrm_resource_get_string and the
+ * functions based on it. The cache holds up to size results and is
+ * invalidated whenever the database is modified.
+ *
+ * @param database The database to enable the cache for.
+ * @param size The number of results to cache. Zero disables the cache.
+ * @returns 0 on success, a negative error code otherwise.
+ */
+int xcb_xrm_database_set_cache_size(xcb_xrm_database_t *database, size_t size) {
+    if (database == NULL)
+        return -FAILURE;
 
-    if (database == NULL || entry == NULL)
-        return;
+    return xcb_xrm_cache_resize(&(database->cache), size);
+}
+
+/*
+ * Returns how many queries have been answered by the cache and how many had
+ * to be resolved against the database.
+ *
+ * @param database The database to inspect.
+ * @param hits Returns the number of queries answered by the cache.
+ * @param misses Returns the number of queries which were not cached.
+ */
+void xcb_xrm_database_get_cache_stats(xcb_xrm_database_t *database, unsigned long *hits, unsigned long *misses) {
+    *hits = database == NULL ? 0 : database->cache.hits;
+    *misses = database == NULL ? 0 : database->cache.misses;
+}
 
-    /* Let's see whether this is a duplicate entry. */
-    current = TAILQ_FIRST(database);
-    while (current != NULL) {
-        xcb_xrm_entry_t *previous = TAILQ_PREV(current, xcb_xrm_database_t, entries);
+/*
+ * Returns statistics about the database.
+ *
+ * @param database The database to inspect.
+ * @param stats Returns the statistics.
+ * @returns 0 on success, a negative error code otherwise.
+ */
+int xcb_xrm_database_get_stats(xcb_xrm_database_t *database, xcb_xrm_database_stats_t *stats) {
+    xcb_xrm_entry_t *entry;
 
-        if (xcb_xrm_entry_compare(entry, current) == 0) {
-            if (!override) {
-                xcb_xrm_entry_free(entry);
-                return;
-            }
+    if (database == NULL || stats == NULL)
+        return -FAILURE;
 
-            TAILQ_REMOVE(database, current, entries);
-            xcb_xrm_entry_free(current);
+    xcb_xrm_database_lock(database);
+    __database_load_all(database);
 
-            current = previous;
-            if (current == NULL)
-                current = TAILQ_FIRST(database);
-        }
+    *stats = database->stats;
+    stats->lookups = __atomic_load_n(&(database->stats.lookups), __ATOMIC_RELAXED);
+    stats->candidates = __atomic_load_n(&(database->stats.candidates), __ATOMIC_RELAXED);
+    stats->match_time = __atomic_load_n(&(database->stats.match_time), __ATOMIC_RELAXED);
 
-        if (current == NULL)
-            break;
-        current = TAILQ_NEXT(current, entries);
-    }
+    stats->num_entries = database->num_entries;
+    stats->num_components = 0;
+    TAILQ_FOREACH(entry, &(database->entries), entries)
+        stats->num_components += xcb_xrm_entry_num_components(entry);
+    stats->storage_size = database->arena.total_size;
+
+    xcb_xrm_database_unlock(database);
+    return SUCCESS;
+}
 
-    TAILQ_INSERT_TAIL(database, entry, entries);
+/*
+ * Installs a callback which is called for every lookup taking at least
+ * threshold nanoseconds.
+ *
+ * @param database The database to trace.
+ * @param trace The callback or NULL.
+ * @param data Passed to the callback.
+ * @param threshold The minimum duration of the lookups to report.
+ */
+void xcb_xrm_database_set_trace(xcb_xrm_database_t *database, xcb_xrm_trace_t trace, void *data,
+        uint64_t threshold) {
+    if (database == NULL)
+        return;
+
+    database->trace = trace;
+    database->trace_data = data;
+    database->trace_threshold = threshold;
+}
+
+/*
+ * Compiles the database into a compact, read-only layout which is used for
+ * all further queries until the database is modified.
+ *
+ * @param database The database to freeze.
+ * @returns 0 on success, a negative error code otherwise.
+ */
+int xcb_xrm_database_freeze(xcb_xrm_database_t *database) {
+    xcb_xrm_frozen_t *frozen;
+
+    if (database == NULL)
+        return -FAILURE;
+
+    /* A concurrent database is always frozen. */
+    if (database->concurrent)
+        return SUCCESS;
+
+    /* Lookups in the frozen index cannot parse deferred lines. */
+    __database_load_all(database);
+
+    frozen = xcb_xrm_frozen_new(database->root);
+    if (frozen == NULL)
+        return -FAILURE;
+    frozen->generation = database->generation;
+
+    xcb_xrm_frozen_free(database->frozen);
+    database->frozen = frozen;
+    return SUCCESS;
+}
+
+/*
+ * Allows the database to be used by several threads at the same time.
+ * Lookups never block, while modifications are serialized and publish a new
+ * frozen copy of the database.
+ *
+ * @param database The database to share between threads.
+ * @returns 0 on success, a negative error code otherwise.
+ */
+int xcb_xrm_database_enable_concurrency(xcb_xrm_database_t *database) {
+    if (database == NULL)
+        return -FAILURE;
+
+    if (database->concurrent)
+        return SUCCESS;
+
+    if (xcb_xrm_database_freeze(database) < 0)
+        return -FAILURE;
+
+    if (pthread_mutex_init(&(database->mutex), NULL) != 0)
+        return -FAILURE;
+
+    database->concurrent = true;
+    return SUCCESS;
+}
+
+/*
+ * Prepares a modification of the database. For a concurrent database, this
+ * waits until all other modifications are done.
+ *
+ */
+void xcb_xrm_database_lock(xcb_xrm_database_t *database) {
+    if (database != NULL && database->concurrent)
+        pthread_mutex_lock(&(database->mutex));
+}
+
+/*
+ * Finishes a modification of the database. For a concurrent database, this
+ * publishes a new frozen index if the database has been modified.
+ *
+ */
+void xcb_xrm_database_unlock(xcb_xrm_database_t *database) {
+    if (database == NULL || !database->concurrent)
+        return;
+
+    if (database->stale)
+        __database_publish(database);
+
+    pthread_mutex_unlock(&(database->mutex));
+}
+
+/*
+ * Returns the frozen index to use for a lookup or NULL if the database is not
+ * frozen.
+ *
+ */
+const xcb_xrm_frozen_t *xcb_xrm_database_read_begin(xcb_xrm_database_t *database) {
+    if (!database->concurrent)
+        return database->frozen;
+
+    /* Announce the lookup before picking the index, so that a modification
+     * which sees no lookups running knows that all future lookups will see
+     * the index it published. */
+    __atomic_add_fetch(&(database->readers), 1, __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&(database->frozen), __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Finishes a lookup started with @ref xcb_xrm_database_read_begin.
+ *
+ */
+void xcb_xrm_database_read_end(xcb_xrm_database_t *database) {
+    if (database->concurrent)
+        __atomic_sub_fetch(&(database->readers), 1, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Inserts the entry into the database. The entry must have been allocated
+ * from the database's arena.
+ *
+ */
+void xcb_xrm_database_put(xcb_xrm_database_t *database, xcb_xrm_entry_t *entry, bool override) {
+    xcb_xrm_node_t *node;
+
+    if (database == NULL || entry == NULL)
+        return;
+
+    /* Deferred lines with the same first component have been inserted
+     * before this entry. */
+    if (database->lazy != NULL) {
+        xcb_xrm_component_t *component = &(entry->components[0]);
+        if (entry->num_components > 0 && component->type == CT_NORMAL && component->binding_type == BT_TIGHT)
+            xcb_xrm_database_load(database, component->quark);
+    }
+
+    /* The index has exactly one node per specifier, so it also tells us
+     * whether this is a duplicate entry. Discarded entries are left in the
+     * arena. */
+    node = xcb_xrm_node_find(database->root, entry, true);
+    if (node == NULL)
+        return;
+
+    if (node->entry != NULL) {
+        database->stats.duplicates++;
+        database->num_discarded++;
+        if (!override)
+            return;
+
+        TAILQ_REMOVE(&(database->entries), node->entry, entries);
+        database->num_entries--;
+    }
+
+    entry->position = database->next_position++;
+    node->entry = entry;
+    TAILQ_INSERT_TAIL(&(database->entries), entry, entries);
+    database->num_entries++;
+
+    __database_invalidate(database);
+}
+
+/*
+ * Parses the deferred lines of the database which might match a query whose
+ * first name or class is the given quark.
+ *
+ */
+void xcb_xrm_database_load(xcb_xrm_database_t *database, xcb_xrm_quark_t quark) {
+    xcb_xrm_lazy_bucket_t *bucket;
+    uint64_t start;
+
+    if (database->lazy == NULL || (bucket = xcb_xrm_lazy_find(database->lazy, quark)) == NULL)
+        return;
+
+    start = get_time();
+    for (size_t i = 0; i < bucket->num_lines; i++) {
+        xcb_xrm_lazy_line_t *line = &(bucket->lines[i]);
+        xcb_xrm_entry_t *entry;
+
+        if (xcb_xrm_entry_parse_length(database->lazy->buffer + line->offset, line->length, &entry, false,
+                    &(database->arena)) == 0)
+            __database_insert(database, entry, line->position);
+    }
+
+    /* The lines have positions from before the entries which are in the
+     * database already. */
+    database->unsorted = true;
+    xcb_xrm_lazy_release(database->lazy, bucket);
+    if (database->lazy->num_lines == 0) {
+        xcb_xrm_lazy_free(database->lazy);
+        database->lazy = NULL;
+    }
+
+    database->stats.parse_time += get_time() - start;
+}
+
+/*
+ * Changes the database to contain exactly the entries of source, reporting
+ * the specifiers of all entries which have been inserted, removed or
+ * changed. The source database is not modified.
+ *
+ */
+int xcb_xrm_database_update(xcb_xrm_database_t *database, xcb_xrm_database_t *source, char ***changed_keys) {
+    xcb_xrm_entry_t *entry;
+    xcb_xrm_entry_t *next;
+    size_t num_changed = 0;
+    bool failed = false;
+
+    if (changed_keys != NULL)
+        *changed_keys = NULL;
+    if (database == NULL || source == NULL)
+        return -FAILURE;
+
+    xcb_xrm_database_lock(database);
+    __database_load_all(database);
+    __database_load_all(source);
+
+    /* Remove the entries whose specifier does not exist anymore. */
+    for (entry = TAILQ_FIRST(&(database->entries)); entry != NULL; entry = next) {
+        xcb_xrm_node_t *node = xcb_xrm_node_find(source->root, entry, false);
+        next = TAILQ_NEXT(entry, entries);
+
+        if (node != NULL && node->entry != NULL)
+            continue;
+
+        failed |= __database_add_change(changed_keys, &num_changed, entry) < 0;
+        __database_remove(database, entry);
+    }
+
+    /* Insert new entries and those whose value changed. We only copy these
+     * few entries instead of taking over the source database's arena. */
+    TAILQ_FOREACH(entry, &(source->entries), entries) {
+        xcb_xrm_node_t *node = xcb_xrm_node_find(database->root, entry, false);
+        xcb_xrm_entry_t *copy;
+
+        if (node != NULL && node->entry != NULL && strcmp(node->entry->value, entry->value) == 0)
+            continue;
+
+        failed |= __database_add_change(changed_keys, &num_changed, entry) < 0;
+
+        copy = xcb_xrm_entry_copy(entry, &(database->arena));
+        if (copy == NULL) {
+            failed = true;
+            continue;
+        }
+
+        xcb_xrm_database_put(database, copy, true);
+    }
+
+    /* Every update leaves the removed and replaced entries behind, so the
+     * arena would keep growing. Lookups in a concurrent database might still
+     * use them, though. */
+    if (!database->concurrent && database->num_discarded > database->num_entries)
+        __database_compact(database);
+
+    xcb_xrm_database_unlock(database);
+
+    if (failed) {
+        if (changed_keys != NULL && *changed_keys != NULL) {
+            for (size_t i = 0; i < num_changed; i++)
+                FREE((*changed_keys)[i]);
+            FREE(*changed_keys);
+        }
+        return -FAILURE;
+    }
+
+    return num_changed;
+}
+
+static xcb_xrm_database_t *__database_new(void) {
+    xcb_xrm_database_t *database = calloc(1, sizeof(struct xcb_xrm_database_t));
+    if (database == NULL)
+        return NULL;
+
+    TAILQ_INIT(&(database->entries));
+    database->root = xcb_xrm_node_new();
+    if (database->root == NULL) {
+        FREE(database);
+        return NULL;
+    }
+
+    return database;
+}
+
+static void __database_put_line(xcb_xrm_database_t *database, const char *line, size_t len) {
+    xcb_xrm_entry_t *entry;
+
+    /* Ignore comments and directives. The specification guarantees that no
+     * whitespace is allowed before these characters. */
+    if (len == 0 || line[0] == '!' || line[0] == '#')
+        return;
+
+    if (xcb_xrm_entry_parse_length(line, len, &entry, false, &(database->arena)) == 0) {
+        xcb_xrm_database_put(database, entry, true);
+    }
+}
+
+/* Defers parsing the line if it starts with a tightly bound normal component,
+ * reserving the position of its entry. All other lines, including those
+ * starting with whitespace, are parsed right away. */
+static bool __database_defer_line(xcb_xrm_database_t *database, const char *line, size_t len) {
+    xcb_xrm_quark_t quark;
+    size_t i = 0;
+
+    while (i < len && (line[i] == '_' || line[i] == '-' || (line[i] >= '0' && line[i] <= '9') ||
+                (line[i] >= 'a' && line[i] <= 'z') || (line[i] >= 'A' && line[i] <= 'Z')))
+        i++;
+
+    if (i == 0 || i == len || (line[i] != '.' && line[i] != '*' && line[i] != ':'))
+        return false;
+
+    quark = xcb_xrm_quark_intern(line, i, NULL);
+    if (quark == XCB_XRM_NULLQUARK ||
+            xcb_xrm_lazy_add(database->lazy, quark, line, len, database->next_position) < 0)
+        return false;
+
+    database->next_position++;
+    return true;
+}
+
+/* Inserts an entry parsed from a deferred line with the given position. Of
+ * two entries with the same specifier, the one with the higher position
+ * wins, just as if the lines had been parsed in order. */
+static void __database_insert(xcb_xrm_database_t *database, xcb_xrm_entry_t *entry, unsigned long position) {
+    xcb_xrm_node_t *node = xcb_xrm_node_find(database->root, entry, true);
+    if (node == NULL)
+        return;
+
+    if (node->entry != NULL) {
+        database->stats.duplicates++;
+        database->num_discarded++;
+        if (node->entry->position > position)
+            return;
+
+        TAILQ_REMOVE(&(database->entries), node->entry, entries);
+        database->num_entries--;
+    }
+
+    entry->position = position;
+    node->entry = entry;
+    TAILQ_INSERT_TAIL(&(database->entries), entry, entries);
+    database->num_entries++;
+}
+
+/* Parses all deferred lines and sorts the entries by their position, so that
+ * they can be used like those of any other database. */
+static void __database_load_all(xcb_xrm_database_t *database) {
+    xcb_xrm_entry_t **entries;
+    xcb_xrm_entry_t *entry;
+    size_t i = 0;
+
+    if (database == NULL)
+        return;
+
+    while (database->lazy != NULL) {
+        xcb_xrm_lazy_t *lazy = database->lazy;
+        for (size_t j = 0; database->lazy == lazy && j < lazy->size_buckets; j++)
+            xcb_xrm_database_load(database, lazy->buckets[j].quark);
+    }
+
+    if (!database->unsorted || database->num_entries == 0)
+        return;
+
+    /* If this fails, the entries are sorted by the next caller. */
+    entries = malloc(database->num_entries * sizeof(xcb_xrm_entry_t *));
+    if (entries == NULL)
+        return;
+
+    TAILQ_FOREACH(entry, &(database->entries), entries)
+        entries[i++] = entry;
+    qsort(entries, database->num_entries, sizeof(xcb_xrm_entry_t *), __database_compare_positions);
+
+    TAILQ_INIT(&(database->entries));
+    for (i = 0; i < database->num_entries; i++)
+        TAILQ_INSERT_TAIL(&(database->entries), entries[i], entries);
+
+    FREE(entries);
+    database->unsorted = false;
+}
+
+static int __database_compare_positions(const void *first, const void *second) {
+    const xcb_xrm_entry_t *entry_first = *(xcb_xrm_entry_t * const *) first;
+    const xcb_xrm_entry_t *entry_second = *(xcb_xrm_entry_t * const *) second;
+
+    if (entry_first->position < entry_second->position)
+        return -1;
+
+    return entry_first->position > entry_second->position;
+}
+
+/* Appends a chunk to a database_string_t, keeping it NUL-terminated. */
+static int __database_append_string(void *data, const char *buffer, size_t length) {
+    database_string_t *str = data;
+
+    if (str->length + length + 1 > str->size) {
+        size_t new_size = MAX(2 * str->size, str->length + length + 1);
+        char *new_data = realloc(str->data, new_size);
+        if (new_data == NULL)
+            return -FAILURE;
+
+        str->data = new_data;
+        str->size = new_size;
+    }
+
+    memcpy(str->data + str->length, buffer, length);
+    str->length += length;
+    str->data[str->length] = '\0';
+    return SUCCESS;
+}
+
+/* Replaces the frozen index of a concurrent database by a new one. The caller
+ * must hold the database's mutex. */
+static void __database_publish(xcb_xrm_database_t *database) {
+    xcb_xrm_frozen_t *previous;
+
+    /* If this fails, lookups keep using the old index and the next
+     * modification tries again. */
+    xcb_xrm_frozen_t *frozen = xcb_xrm_frozen_new(database->root);
+    if (frozen == NULL)
+        return;
+    frozen->generation = database->generation;
+
+    previous = __atomic_exchange_n(&(database->frozen), frozen, __ATOMIC_SEQ_CST);
+    previous->next = database->retired;
+    database->retired = previous;
+    database->stale = false;
+
+    /* Lookups starting from now on use the new index, so if none is running
+     * right now, none can use any of the replaced ones. */
+    if (__atomic_load_n(&(database->readers), __ATOMIC_SEQ_CST) == 0)
+        __database_free_retired(database);
+}
+
+static void __database_free_retired(xcb_xrm_database_t *database) {
+    while (database->retired != NULL) {
+        xcb_xrm_frozen_t *next = database->retired->next;
+        xcb_xrm_frozen_free(database->retired);
+        database->retired = next;
+    }
+}
+
+/* Invalidates all cached query results and the frozen index. Lookups in a
+ * concurrent database might still use the frozen index, so it is replaced
+ * once the modification is done. */
+static void __database_invalidate(xcb_xrm_database_t *database) {
+    database->generation++;
+    if (database->concurrent) {
+        database->stale = true;
+    } else {
+        xcb_xrm_frozen_free(database->frozen);
+        database->frozen = NULL;
+    }
+}
+
+/* Removes the entry from the database. Like discarded duplicates, it is left
+ * in the arena, but the nodes which only existed for it are free'd. */
+static void __database_remove(xcb_xrm_database_t *database, xcb_xrm_entry_t *entry) {
+    xcb_xrm_node_remove(database->root, entry);
+
+    TAILQ_REMOVE(&(database->entries), entry, entries);
+    database->num_entries--;
+    database->num_discarded++;
+    __database_invalidate(database);
+}
+
+/* Copies all entries of the database into a new arena and frees the old one
+ * including the entries which have been removed. If memory cannot be
+ * allocated, the database is left unchanged. */
+static int __database_compact(xcb_xrm_database_t *database) {
+    struct entries_head entries = TAILQ_HEAD_INITIALIZER(entries);
+    xcb_xrm_arena_t arena = { NULL, 0 };
+    xcb_xrm_entry_t *entry;
+    xcb_xrm_entry_t *copy;
+
+    TAILQ_FOREACH(entry, &(database->entries), entries) {
+        copy = xcb_xrm_entry_copy(entry, &arena);
+        if (copy == NULL) {
+            xcb_xrm_arena_free(&arena);
+            return -FAILURE;
+        }
+
+        copy->position = entry->position;
+        TAILQ_INSERT_TAIL(&entries, copy, entries);
+    }
+
+    /* Both lists are in the same order, so each node can be pointed to the
+     * copy of its entry. */
+    copy = TAILQ_FIRST(&entries);
+    TAILQ_FOREACH(entry, &(database->entries), entries) {
+        xcb_xrm_node_find(database->root, entry, false)->entry = copy;
+        copy = TAILQ_NEXT(copy, entries);
+    }
+
+    TAILQ_INIT(&(database->entries));
+    TAILQ_CONCAT(&(database->entries), &entries, entries);
+    xcb_xrm_arena_free(&(database->arena));
+    database->arena = arena;
+    database->num_discarded = 0;
+
+    __database_invalidate(database);
+    return SUCCESS;
+}
+
+/* Combines the databases like inserting all entries of source into target
+ * in their order would, but merges the index of source into the one of target
+ * instead. The entries of source are moved behind the entries of target. */
+static int __database_merge(xcb_xrm_database_t *target, xcb_xrm_database_t *source, bool override) {
+    database_merge_t merge = { target, source, override };
+    xcb_xrm_entry_t *entry;
+
+    if (xcb_xrm_node_merge(target->root, source->root, override, __database_discard, &merge) < 0)
+        return -FAILURE;
+    source->root = NULL;
+
+    TAILQ_FOREACH(entry, &(source->entries), entries)
+        entry->position += target->next_position;
+    target->next_position += source->next_position;
+    target->num_entries += source->num_entries;
+    TAILQ_CONCAT(&(target->entries), &(source->entries), entries);
+
+    __database_invalidate(target);
+    return SUCCESS;
+}
+
+/* Removes an entry which has been dropped while merging the indexes from its
+ * database. */
+static void __database_discard(xcb_xrm_entry_t *entry, void *data) {
+    database_merge_t *merge = data;
+
+    /* When overriding, only entries of the target are dropped. */
+    xcb_xrm_database_t *database = merge->override ? merge->target : merge->source;
+    TAILQ_REMOVE(&(database->entries), entry, entries);
+    database->num_entries--;
+    merge->target->stats.duplicates++;
+    merge->target->num_discarded++;
+}
+
+/* Appends the specifier of the entry to the NULL-terminated list of changed
+ * specifiers, if one is requested. */
+static int __database_add_change(char ***changed_keys, size_t *num_changed, xcb_xrm_entry_t *entry) {
+    char **new_keys;
+    char *key;
+
+    (*num_changed)++;
+    if (changed_keys == NULL)
+        return SUCCESS;
+
+    key = xcb_xrm_entry_specifier_to_string(entry);
+    if (key == NULL)
+        return -FAILURE;
+
+    new_keys = realloc(*changed_keys, (*num_changed + 1) * sizeof(char *));
+    if (new_keys == NULL) {
+        (*num_changed)--;
+        FREE(key);
+        return -FAILURE;
+    }
+
+    new_keys[*num_changed - 1] = key;
+    new_keys[*num_changed] = NULL;
+    *changed_keys = new_keys;
+    return SUCCESS;
+}
+
+/* Creates a database from the first len bytes of str, which do not need to be
+ * NUL-terminated. Like for strings, parsing stops at a NUL byte. */
+static xcb_xrm_database_t *__database_from_buffer(const char *str, size_t len, database_load_t *load, bool lazy) {
+    uint64_t start = get_time();
+    xcb_xrm_database_t *database;
+    const char *walk = str;
+    const char *end = str + len;
+    char *continued = NULL;
+    size_t continued_size = 0;
+
+    database = __database_new();
+    if (database == NULL)
+        return NULL;
+
+    /* If this fails, all lines are simply parsed right away. */
+    if (lazy)
+        database->lazy = xcb_xrm_lazy_new();
+
+    while (walk < end && *walk != '\0') {
+        const char *line = walk;
+        size_t line_len;
+        bool has_continuations = false;
+
+        /* Find the end of this line. Line continuations are dropped, so they
+         * don't end the line. */
+        while ((walk = find_chars(walk, end, '\n', '\\', '\0')) < end && *walk == '\\') {
+            if (walk + 1 < end && *(walk + 1) == '\n') {
+                has_continuations = true;
+                walk++;
+            }
+
+            walk++;
+        }
+        line_len = walk - line;
+        if (walk < end && *walk == '\n')
+            walk++;
+
+        /* Lines without continuations are parsed right from the input. The
+         * others are copied without the continuations first. */
+        if (has_continuations) {
+            char *outwalk;
+
+            if (line_len + 1 > continued_size) {
+                char *new_continued = realloc(continued, line_len + 1);
+                if (new_continued == NULL) {
+                    FREE(continued);
+                    xcb_xrm_database_free(database);
+                    return NULL;
+                }
+
+                continued = new_continued;
+                continued_size = line_len + 1;
+            }
+
+            outwalk = continued;
+            for (const char *inwalk = line; inwalk < line + line_len; inwalk++) {
+                if (*inwalk == '\\' && inwalk + 1 < line + line_len && *(inwalk + 1) == '\n') {
+                    inwalk++;
+                    continue;
+                }
+
+                *(outwalk++) = *inwalk;
+            }
+
+            *outwalk = '\0';
+            line = continued;
+            line_len = outwalk - continued;
+        }
+
+        if (line_len == 0)
+            continue;
+
+        /* Handle include directives. */
+        if (line[0] == '#') {
+            size_t i = 1;
+
+            /* Skip whitespace and quotes. */
+            while (i < line_len && (line[i] == ' ' || line[i] == '\t'))
+                i++;
+
+            if (line_len - i >= strlen("include") && strncmp(&line[i], "include", strlen("include")) == 0) {
+                char *filename;
+                size_t j = line_len - 1;
+
+                i += strlen("include");
+
+                /* Skip whitespace and quotes. */
+                while (i < line_len && (line[i] == ' ' || line[i] == '\t' || line[i] == '"'))
+                    i++;
+                while (j > i && (line[j] == ' ' || line[j] == '\t' || line[j] == '"'))
+                    j--;
+
+                if (i >= line_len) {
+                    /* Only whitespace left in this line. */
+                    continue;
+                }
+
+                filename = strndup(&line[i], j - i + 1);
+                if (filename == NULL)
+                    continue;
+
+                __database_include(database, filename, load);
+                FREE(filename);
+
+                continue;
+            }
+        }
+
+        if (database->lazy == NULL || !__database_defer_line(database, line, line_len))
+            __database_put_line(database, line, line_len);
+    }
+
+    FREE(continued);
+    if (database->lazy != NULL && database->lazy->num_lines == 0) {
+        xcb_xrm_lazy_free(database->lazy);
+        database->lazy = NULL;
+    }
+    database->stats.parse_time = get_time() - start;
+    return database;
+}
+
+/* Parses the first len bytes of str using up to num_threads threads. The
+ * input is split into tasks at line boundaries, and every include directive
+ * becomes a task of its own, so that included files are parsed in parallel,
+ * too. The databases of the tasks are then combined in the order of the
+ * input, which gives the same result as parsing it on one thread. */
+static xcb_xrm_database_t *__database_from_buffer_parallel(const char *str, size_t len, int num_threads,
+        database_load_t *load) {
+    database_pool_t pool = { NULL, 0, 0, 0, load };
+    uint64_t start = get_time();
+    xcb_xrm_database_t *database = NULL;
+    pthread_t *threads;
+    const char *nul;
+    int num_started = 0;
+    bool failed = false;
+
+    /* The parser stops at the first NUL byte. */
+    if ((nul = memchr(str, '\0', len)) != NULL)
+        len = nul - str;
+
+    if (num_threads <= 0)
+        num_threads = MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
+
+    if (num_threads == 1 ||
+        __database_split(&pool, str, len, MAX(PARALLEL_MIN_CHUNK_SIZE, len / (4 * num_threads))) < 0 ||
+        pool.num_tasks <= 1) {
+        FREE(pool.tasks);
+        return __database_from_buffer(str, len, load, false);
+    }
+
+    /* The calling thread works on the tasks, too. If threads cannot be
+     * started, the remaining ones simply do more of the work. */
+    num_threads = MIN((size_t)num_threads, pool.num_tasks);
+    threads = calloc(num_threads - 1, sizeof(pthread_t));
+    if (threads != NULL) {
+        while (num_started < num_threads - 1 &&
+                pthread_create(&threads[num_started], NULL, __database_run_tasks, &pool) == 0)
+            num_started++;
+    }
+
+    __database_run_tasks(&pool);
+    for (int i = 0; i < num_started; i++)
+        pthread_join(threads[i], NULL);
+    FREE(threads);
+
+    for (size_t i = 0; i < pool.num_tasks; i++)
+        failed |= pool.tasks[i].database == NULL;
+
+    for (size_t i = 0; i < pool.num_tasks; i++) {
+        if (failed)
+            xcb_xrm_database_free(pool.tasks[i].database);
+        else if (database == NULL)
+            database = pool.tasks[i].database;
+        else
+            xcb_xrm_database_combine(pool.tasks[i].database, &database, true);
+    }
+
+    FREE(pool.tasks);
+    if (failed)
+        return NULL;
+
+    database->stats.parse_time = get_time() - start;
+    return database;
+}
+
+/* Splits the input into tasks of about chunk_size bytes. Tasks only end at
+ * newlines which are not escaped as line continuations. */
+static int __database_split(database_pool_t *pool, const char *str, size_t len, size_t chunk_size) {
+    const char *end = str + len;
+    const char *walk = str;
+    const char *chunk = str;
+
+    while (walk < end) {
+        const char *line = walk;
+
+        /* Find the start of the next line. */
+        for (;;) {
+            const char *newline = memchr(walk, '\n', end - walk);
+            if (newline == NULL) {
+                walk = end;
+                break;
+            }
+
+            walk = newline + 1;
+            if (newline == str || *(newline - 1) != '\\')
+                break;
+        }
+
+        if (__database_is_include(line, walk)) {
+            if ((line > chunk && __database_add_task(pool, chunk, line - chunk) < 0) ||
+                __database_add_task(pool, line, walk - line) < 0)
+                return -FAILURE;
+            chunk = walk;
+        } else if ((size_t)(walk - chunk) >= chunk_size) {
+            if (__database_add_task(pool, chunk, walk - chunk) < 0)
+                return -FAILURE;
+            chunk = walk;
+        }
+    }
+
+    if (walk > chunk && __database_add_task(pool, chunk, walk - chunk) < 0)
+        return -FAILURE;
+
+    return SUCCESS;
+}
+
+static int __database_add_task(database_pool_t *pool, const char *str, size_t len) {
+    if (pool->num_tasks == pool->size_tasks) {
+        size_t new_size = MAX(16, 2 * pool->size_tasks);
+        database_task_t *new_tasks = realloc(pool->tasks, new_size * sizeof(database_task_t));
+        if (new_tasks == NULL)
+            return -FAILURE;
+
+        pool->tasks = new_tasks;
+        pool->size_tasks = new_size;
+    }
+
+    pool->tasks[pool->num_tasks++] = (database_task_t) { str, len, NULL };
+    return SUCCESS;
+}
+
+/* Returns whether the line, which ends at end, is an include directive. Lines
+ * which are not recognized here are still handled correctly by the parser,
+ * but included files are parsed as part of their surrounding task. */
+static bool __database_is_include(const char *line, const char *end) {
+    const char *walk = line;
+
+    if (walk == end || *walk != '#')
+        return false;
+
+    walk++;
+    while (walk < end && (*walk == ' ' || *walk == '\t'))
+        walk++;
+
+    return (size_t)(end - walk) >= strlen("include") && strncmp(walk, "include", strlen("include")) == 0;
+}
+
+static void *__database_run_tasks(void *data) {
+    database_pool_t *pool = data;
+    size_t i;
+
+    while ((i = __atomic_fetch_add(&(pool->next_task), 1, __ATOMIC_RELAXED)) < pool->num_tasks) {
+        database_load_t load = { NULL, 0, 0 };
+        bool failed = false;
+
+        /* Files which are included by several tasks are parsed by each of
+         * them, since tasks do not share their state. Only the files being
+         * loaded by the caller are needed to detect cycles, and they are all
+         * still being loaded. */
+        for (size_t j = 0; j < pool->load->num_includes; j++) {
+            database_include_t *include = __database_add_include(&load, NULL);
+            if (include == NULL) {
+                failed = true;
+                break;
+            }
+
+            *include = pool->load->includes[j];
+            include->database = NULL;
+        }
+
+        if (!failed)
+            pool->tasks[i].database = __database_from_buffer(pool->tasks[i].str, pool->tasks[i].len, &load, false);
+        __database_load_free(&load);
+    }
+
+    return NULL;
+}
+
+/* Loads a database from a file. The database is returned to the caller, so
+ * the file stays registered as being loaded. */
+static xcb_xrm_database_t *__database_load_file(const char *filename, int num_threads, database_load_t *load) {
+    xcb_xrm_database_t *database;
+    file_contents_t contents;
+    struct stat stbuf;
+
+    /* The file itself is never done loading, so it cannot be included. */
+    if (filename == NULL || stat(filename, &stbuf) < 0 || __database_add_include(load, &stbuf) == NULL)
+        return NULL;
+
+    if (file_map_contents(filename, &contents) < 0)
+        return NULL;
+
+    /* The parser reads the file contents in place. */
+    if (num_threads == 1)
+        database = __database_from_buffer(contents.data, contents.length, load, false);
+    else
+        database = __database_from_buffer_parallel(contents.data, contents.length, num_threads, load);
+    file_unmap_contents(&contents);
+
+    return database;
+}
+
+/* Inserts the entries of an included file into the database as if they were
+ * part of it. */
+static void __database_include(xcb_xrm_database_t *database, const char *filename, database_load_t *load) {
+    xcb_xrm_database_t *included = NULL;
+    xcb_xrm_entry_t *entry;
+    struct stat stbuf;
+
+    if (stat(filename, &stbuf) < 0)
+        return;
+
+    for (size_t i = 0; i < load->num_includes; i++) {
+        database_include_t *include = &(load->includes[i]);
+        if (include->dev == stbuf.st_dev && include->ino == stbuf.st_ino &&
+            include->mtime.tv_sec == stbuf.st_mtim.tv_sec && include->mtime.tv_nsec == stbuf.st_mtim.tv_nsec) {
+            /* If the file is still being loaded, it includes itself. */
+            if ((included = include->database) == NULL)
+                return;
+            break;
+        }
+    }
+
+    if (included == NULL) {
+        database_include_t *include;
+        size_t index;
+        file_contents_t contents;
+
+        if ((include = __database_add_include(load, &stbuf)) == NULL)
+            return;
+        index = include - load->includes;
+
+        if (file_map_contents(filename, &contents) < 0)
+            return;
+
+        /* The file stays registered, so if parsing failed, it is not tried
+         * again. */
+        included = __database_from_buffer(contents.data, contents.length, load, false);
+        load->includes[index].database = included;
+        file_unmap_contents(&contents);
+
+        if (included == NULL)
+            return;
+    }
+
+    /* The parsed file is kept for further includes, so it is copied. */
+    TAILQ_FOREACH(entry, &(included->entries), entries) {
+        xcb_xrm_entry_t *copy = xcb_xrm_entry_copy(entry, &(database->arena));
+        if (copy != NULL)
+            xcb_xrm_database_put(database, copy, true);
+    }
+}
+
+/* Registers a file as being loaded. If stbuf is NULL, the caller fills in the
+ * returned element. Returns NULL if memory could not be allocated. */
+static database_include_t *__database_add_include(database_load_t *load, const struct stat *stbuf) {
+    database_include_t *include;
+
+    if (load->num_includes == load->size_includes) {
+        size_t new_size = MAX(8, 2 * load->size_includes);
+        database_include_t *new_includes = realloc(load->includes, new_size * sizeof(database_include_t));
+        if (new_includes == NULL)
+            return NULL;
+
+        load->includes = new_includes;
+        load->size_includes = new_size;
+    }
+
+    include = &(load->includes[load->num_includes++]);
+    include->database = NULL;
+    if (stbuf != NULL) {
+        include->dev = stbuf->st_dev;
+        include->ino = stbuf->st_ino;
+        include->mtime = stbuf->st_mtim;
+    }
+
+    return include;
+}
+
+static void __database_load_free(database_load_t *load) {
+    for (size_t i = 0; i < load->num_includes; i++)
+        xcb_xrm_database_free(load->includes[i].database);
+
+    FREE(load->includes);
+    load->num_includes = 0;
+    load->size_includes = 0;
+}
+
+/* Returns a hash identifying the display of the given root window. The
+ * connection does not know the name it was opened with, so we use $DISPLAY
+ * like XOpenDisplay does by default. */
+static uint64_t __database_shared_display(xcb_window_t root) {
+    const char *display = getenv("DISPLAY");
+
+    if (display == NULL)
+        display = "";
+
+    return hash_bytes_64(display, strlen(display)) ^ root;
+}
+
+/* Returns the name of the shared memory snapshot of the given display whose
+ * resources have the given hash. Only snapshots of the same user are
+ * considered, so that no one else can make us load theirs. */
+static void __database_shared_name(char *name, uint64_t display, uint64_t hash) {
+    snprintf(name, SHARED_NAME_SIZE, "/xcb-xrm-%u-%016llx-%016llx", (unsigned int) geteuid(),
+            (unsigned long long) display, (unsigned long long) hash);
+}
+
+/* Returns the name of the object which holds the hash of the current snapshot
+ * of the given display. */
+static void __database_current_name(char *name, uint64_t display) {
+    snprintf(name, SHARED_NAME_SIZE, "/xcb-xrm-%u-%016llx", (unsigned int) geteuid(),
+            (unsigned long long) display);
+}
+
+/* Loads the database from the given shared memory snapshot. Returns NULL if
+ * it does not exist or is not complete yet. Snapshots which cannot be loaded
+ * or which have been left incomplete are removed so that they are published
+ * again. */
+static xcb_xrm_database_t *__database_from_shared(const char *name) {
+    xcb_xrm_database_t *database = NULL;
+    struct stat stbuf;
+    void *data = MAP_FAILED;
+    bool complete = false;
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return NULL;
+
+    /* Anyone can create an object with this name, so make sure that we
+     * published it ourselves. */
+    if (fstat(fd, &stbuf) < 0 || stbuf.st_uid != geteuid()) {
+        close(fd);
+        return NULL;
+    }
+
+    if ((size_t) stbuf.st_size >= sizeof(xcb_xrm_blob_header_t))
+        data = mmap(NULL, stbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    /* The magic is written last, so it tells whether the snapshot is
+     * complete. The blob is validated as usual. */
+    if (data != MAP_FAILED) {
+        complete = __atomic_load_n((uint32_t *) data, __ATOMIC_ACQUIRE) == BLOB_MAGIC;
+        if (complete)
+            database = xcb_xrm_database_from_blob(data, stbuf.st_size);
+        munmap(data, stbuf.st_size);
+    }
+
+    /* If the publisher crashed, the snapshot would never be completed, and
+     * nobody could publish it again. */
+    if (database == NULL && (complete || time(NULL) - stbuf.st_mtime >= SHARED_STALE_SECONDS))
+        shm_unlink(name);
+
+    return database;
+}
+
+/* Publishes the database as the snapshot of the given display whose resources
+ * have the given hash. This is done on a best effort basis: if the snapshot
+ * exists already, e.g., because another client is publishing it right now, or
+ * anything fails, nothing is done. */
+static void __database_share(xcb_xrm_database_t *database, uint64_t display, uint64_t hash) {
+    char name[SHARED_NAME_SIZE];
+    void *blob;
+    size_t length;
+    void *data;
+    int fd;
+
+    if (xcb_xrm_database_serialize(database, &blob, &length) < 0)
+        return;
+
+    __database_shared_name(name, display, hash);
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        goto done;
+
+    /* This is done right away, so that even a snapshot we fail to complete is
+     * removed once it is superseded. */
+    __database_set_current(display, hash);
+
+    if (ftruncate(fd, length) < 0 ||
+            (data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        shm_unlink(name);
+        goto done_close;
+    }
+
+    /* Other clients may map the snapshot while we are writing it, so the
+     * magic which marks it as complete comes last. */
+    memcpy((char *) data + sizeof(uint32_t), (char *) blob + sizeof(uint32_t), length - sizeof(uint32_t));
+    __atomic_store_n((uint32_t *) data, BLOB_MAGIC, __ATOMIC_RELEASE);
+    munmap(data, length);
+
+done_close:
+    close(fd);
+done:
+    FREE(blob);
+}
+
+/* Records the snapshot with the given hash as the current one of the display
+ * and removes the one it supersedes. Every snapshot is superseded by only one
+ * publisher, so each is removed exactly once. */
+static void __database_set_current(uint64_t display, uint64_t hash) {
+    char name[SHARED_NAME_SIZE];
+    struct stat stbuf;
+    uint64_t *current;
+    uint64_t previous;
+    int fd;
+
+    __database_current_name(name, display);
+    fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+    if (fd < 0)
+        return;
+
+    /* Clients which create the object at the same time both extend it, which
+     * keeps it zeroed. */
+    if (fstat(fd, &stbuf) < 0 || stbuf.st_uid != geteuid() ||
+            ((size_t) stbuf.st_size < sizeof(uint64_t) && ftruncate(fd, sizeof(uint64_t)) < 0) ||
+            (current = mmap(NULL, sizeof(uint64_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        return;
+    }
+    close(fd);
+
+    previous = __atomic_exchange_n(current, hash, __ATOMIC_ACQ_REL);
+    munmap(current, sizeof(uint64_t));
+
+    /* Zero means that no snapshot has been published yet. */
+    if (previous != 0 && previous != hash) {
+        __database_shared_name(name, display, previous);
+        shm_unlink(name);
+    }
 }
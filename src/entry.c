@@ -32,18 +32,45 @@
 #include "util.h"
 
 /**
- * Appends a single character to the current buffer.
- * If the buffer is not yet initialized or has been invalidated, it will be set up.
+ * Allocates zero-initialized memory from the arena or, if none is given, from
+ * the heap.
  *
  */
-static void xcb_xrm_append_char(xcb_xrm_entry_t *entry, xcb_xrm_entry_parser_state_t *state,
-        const char str) {
+static void *xcb_xrm_entry_alloc(xcb_xrm_arena_t *arena, size_t size) {
+    if (arena == NULL)
+        return calloc(1, size);
+
+    return xcb_xrm_arena_alloc(arena, size);
+}
+
+/**
+ * Appends a single character to the current component.
+ * As long as the component is contiguous in the input, it is only tracked as
+ * a range of the input. Only if characters have been skipped in between, the
+ * component is copied into the state's buffer.
+ *
+ */
+static int xcb_xrm_append_char(xcb_xrm_entry_parser_state_t *state, const char *walk) {
     if (state->buffer_pos == NULL) {
-        memset(&(state->buffer), 0, sizeof(state->buffer));
-        state->buffer_pos = state->buffer;
+        if (state->component_len == 0)
+            state->component = walk;
+
+        if (state->component + state->component_len == walk) {
+            state->component_len++;
+            return SUCCESS;
+        }
+
+        if (state->buffer == NULL && (state->buffer = malloc(state->buffer_size)) == NULL)
+            return -FAILURE;
+
+        memcpy(state->buffer, state->component, state->component_len);
+        state->buffer_pos = state->buffer + state->component_len;
+        state->component = state->buffer;
     }
 
-    *(state->buffer_pos++) = str;
+    *(state->buffer_pos++) = *walk;
+    state->component_len++;
+    return SUCCESS;
 }
 
 /**
@@ -51,41 +78,103 @@ static void xcb_xrm_append_char(xcb_xrm_entry_t *entry, xcb_xrm_entry_parser_sta
  * This function does not check whether there is an open buffer.
  *
  */
-static void xcb_xrm_insert_component(xcb_xrm_entry_t *entry, xcb_xrm_component_type_t type,
-        xcb_xrm_binding_type_t binding_type, const char *str) {
-    xcb_xrm_component_t *new = calloc(1, sizeof(struct xcb_xrm_component_t));
-    if (new == NULL)
+static void xcb_xrm_insert_component(xcb_xrm_entry_parser_state_t *state, xcb_xrm_component_type_t type,
+        xcb_xrm_binding_type_t binding_type, const char *str, size_t len) {
+    xcb_xrm_quark_t quark = XCB_XRM_NULLQUARK;
+    const char *name = NULL;
+    xcb_xrm_component_t *new;
+
+    if (str != NULL && (quark = xcb_xrm_quark_intern(str, len, &name)) == XCB_XRM_NULLQUARK)
         return;
 
-    if (str != NULL) {
-        new->name = strdup(str);
-        if (new->name == NULL) {
-            FREE(new);
-            return;
+    /* The first components are stored on the caller's stack. */
+    if (state->num_components == state->size_components) {
+        int new_size = 2 * state->size_components;
+        xcb_xrm_component_t *new_components;
+
+        if (state->size_components > ENTRY_STACK_COMPONENTS) {
+            new_components = realloc(state->components, new_size * sizeof(xcb_xrm_component_t));
+        } else if ((new_components = malloc(new_size * sizeof(xcb_xrm_component_t))) != NULL) {
+            memcpy(new_components, state->components, state->num_components * sizeof(xcb_xrm_component_t));
         }
+
+        if (new_components == NULL)
+            return;
+
+        state->components = new_components;
+        state->size_components = new_size;
     }
 
+    new = &(state->components[state->num_components++]);
+    new->quark = quark;
+    new->name = name;
     new->type = type;
     new->binding_type = binding_type;
-    TAILQ_INSERT_TAIL(&(entry->components), new, components);
 }
 
 /**
- * Finalize the current buffer by writing it into a component if necessary.
- * This function also resets the buffer to a clean slate.
+ * Finalize the current component by inserting it into the entry if necessary.
+ * This function also resets the component to a clean slate.
  *
  */
-static void xcb_xrm_finalize_component(xcb_xrm_entry_t *entry, xcb_xrm_entry_parser_state_t *state) {
-    if (state->buffer_pos != NULL && state->buffer_pos != state->buffer) {
-        *(state->buffer_pos) = '\0';
-        xcb_xrm_insert_component(entry, CT_NORMAL, state->current_binding_type, state->buffer);
+static void xcb_xrm_finalize_component(xcb_xrm_entry_parser_state_t *state) {
+    if (state->component_len > 0) {
+        xcb_xrm_insert_component(state, CT_NORMAL, state->current_binding_type,
+                state->component, state->component_len);
     }
 
-    memset(&(state->buffer), 0, sizeof(state->buffer));
-    state->buffer_pos = state->buffer;
+    state->component = NULL;
+    state->component_len = 0;
+    state->buffer_pos = NULL;
     state->current_binding_type = BT_TIGHT;
 }
 
+/**
+ * Allocates the entry for the components which have been read.
+ *
+ */
+static xcb_xrm_entry_t *xcb_xrm_create_entry(xcb_xrm_entry_parser_state_t *state, size_t value_size) {
+    xcb_xrm_entry_t *entry = xcb_xrm_entry_new(state->arena, state->num_components, value_size);
+    if (entry == NULL)
+        return NULL;
+
+    memcpy(entry->components, state->components, state->num_components * sizeof(xcb_xrm_component_t));
+    return entry;
+}
+
+/*
+ * Allocates an entry with room for the given number of components and a value
+ * of value_size bytes, including the terminating NUL byte. If value_size is
+ * zero, the entry has no value.
+ *
+ */
+xcb_xrm_entry_t *xcb_xrm_entry_new(xcb_xrm_arena_t *arena, int num_components, size_t value_size) {
+    size_t size = sizeof(struct xcb_xrm_entry_t) + num_components * sizeof(xcb_xrm_component_t);
+    xcb_xrm_entry_t *entry = xcb_xrm_entry_alloc(arena, size + value_size);
+    if (entry == NULL)
+        return NULL;
+
+    entry->num_components = num_components;
+    if (value_size > 0)
+        entry->value = (char *) entry + size;
+    return entry;
+}
+
+/*
+ * Computes the hash of the entry's components.
+ *
+ */
+void xcb_xrm_entry_update_hash(xcb_xrm_entry_t *entry) {
+    uint32_t hash = 2166136261u;
+
+    for (int i = 0; i < entry->num_components; i++) {
+        hash = (hash ^ (uint32_t) entry->components[i].quark) * 16777619u;
+        hash = (hash ^ (uint32_t) (entry->components[i].type << 1 | entry->components[i].binding_type)) * 16777619u;
+    }
+
+    entry->hash = hash;
+}
+
 /*
  * Parses a specific resource string.
  *
@@ -97,35 +186,43 @@ static void xcb_xrm_finalize_component(xcb_xrm_entry_t *entry, xcb_xrm_entry_par
  * @return 0 on success, a negative error code otherwise.
  *
  */
-int xcb_xrm_entry_parse(const char *_str, xcb_xrm_entry_t **_entry, bool resource_only) {
-    // TODO XXX Allow arbitrary sizes.
-    char *str;
+int xcb_xrm_entry_parse(const char *str, xcb_xrm_entry_t **entry, bool resource_only) {
+    return xcb_xrm_entry_parse_length(str, strlen(str), entry, resource_only, NULL);
+}
+
+/*
+ * Parses a specific resource string of the given length. The string does not
+ * need to be terminated.
+ *
+ * @param str The resource string.
+ * @param len The length of the resource string.
+ * @param entry A return struct that will contain the parsed resource. The
+ * memory will be allocated dynamically, so it must be freed.
+ * @param resource_only If true, only components of type CT_NORMAL are allowed.
+ * @param arena If not NULL, all memory for the entry is allocated from this
+ * arena and the entry must not be freed.
+ *
+ * @return 0 on success, a negative error code otherwise.
+ *
+ */
+int xcb_xrm_entry_parse_length(const char *str, size_t len, xcb_xrm_entry_t **_entry, bool resource_only,
+        xcb_xrm_arena_t *arena) {
+    const char *end = str + len;
     xcb_xrm_entry_t *entry = NULL;
-    xcb_xrm_component_t *last;
-    char value_buf[4096];
-    char *value_pos = value_buf;
+    xcb_xrm_component_t stack_components[ENTRY_STACK_COMPONENTS];
+    char *value_pos = NULL;
+    size_t value_size = 0;
 
     xcb_xrm_entry_parser_state_t state = {
         .chunk = CS_INITIAL,
         .current_binding_type = BT_TIGHT,
+        .buffer_size = len,
+        .components = stack_components,
+        .size_components = ENTRY_STACK_COMPONENTS,
+        .arena = arena,
     };
 
-    /* Copy the input string since it's const. */
-    str = strdup(_str);
-    if (str == NULL)
-        return -FAILURE;
-
-    /* Allocate memory for the return parameter. */
-    *_entry = calloc(1, sizeof(struct xcb_xrm_entry_t));
-    if (_entry == NULL) {
-        FREE(str);
-        return -FAILURE;
-    }
-
-    entry = *_entry;
-    TAILQ_INIT(&(entry->components));
-
-    for (char *walk = str; *walk != '\0'; walk++) {
+    for (const char *walk = str; walk < end && *walk != '\0'; walk++) {
         switch (*walk) {
             case '.':
             case '*':
@@ -138,7 +235,7 @@ int xcb_xrm_entry_parse(const char *_str, xcb_xrm_entry_t **_entry, bool resourc
                     goto done_error;
                 }
 
-                xcb_xrm_finalize_component(entry, &state);
+                xcb_xrm_finalize_component(&state);
                 state.current_binding_type = (*walk == '.') ? BT_TIGHT : BT_LOOSE;
                 break;
             case '?':
@@ -151,7 +248,7 @@ int xcb_xrm_entry_parse(const char *_str, xcb_xrm_entry_t **_entry, bool resourc
                     goto done_error;
                 }
 
-                xcb_xrm_insert_component(entry, CT_WILDCARD, state.current_binding_type, NULL);
+                xcb_xrm_insert_component(&state, CT_WILDCARD, state.current_binding_type, NULL, 0);
                 break;
             case ' ':
             case '\t':
@@ -170,7 +267,7 @@ int xcb_xrm_entry_parse(const char *_str, xcb_xrm_entry_t **_entry, bool resourc
                 if (state.chunk == CS_INITIAL) {
                     goto done_error;
                 } else if (state.chunk == CS_COMPONENTS) {
-                    xcb_xrm_finalize_component(entry, &state);
+                    xcb_xrm_finalize_component(&state);
                     state.chunk = CS_PRE_VALUE_WHITESPACE;
                     break;
                 } else if (state.chunk >= CS_PRE_VALUE_WHITESPACE) {
@@ -196,31 +293,51 @@ process_normally:
                 }
 
                 if (state.chunk < CS_VALUE) {
-                    xcb_xrm_append_char(entry, &state, *walk);
-                } else {
-                    if (*walk == '\\') {
-                        if (*(walk + 1) == ' ') {
-                            *(value_pos++) = ' ';
-                            walk++;
-                        } else if (*(walk + 1) == '\t') {
-                            *(value_pos++) = '\t';
-                            walk++;
-                        } else if (*(walk + 1) == '\\') {
-                            *(value_pos++) = '\\';
-                            walk++;
-                        } else if (*(walk + 1) == 'n') {
-                            *(value_pos++) = '\n';
-                            walk++;
-                        } else if (isdigit(*(walk + 1)) && isdigit(*(walk + 2)) && isdigit(*(walk + 3)) &&
-                                *(walk + 1) < '8' && *(walk + 2) < '8' && *(walk + 3) < '8') {
-                            *(value_pos++) = (*(walk + 1) - '0') * 64 + (*(walk + 2) - '0') * 8 + (*(walk + 3) - '0');
-                            walk += 3;
-                        } else {
-                            *(value_pos++) = *walk;
-                        }
+                    if (xcb_xrm_append_char(&state, walk) < 0)
+                        goto done_error;
+                    break;
+                }
+
+                /* All components have been read by now. The decoded value
+                 * is never longer than the rest of the input, so we can
+                 * write it directly into its final place behind them. */
+                if (value_pos == NULL) {
+                    value_size = end - walk + 1;
+                    entry = xcb_xrm_create_entry(&state, value_size);
+                    if (entry == NULL)
+                        goto done_error;
+                    value_pos = entry->value;
+                }
+
+                if (*walk == '\\' && walk + 1 < end) {
+                    if (*(walk + 1) == ' ') {
+                        *(value_pos++) = ' ';
+                        walk++;
+                    } else if (*(walk + 1) == '\t') {
+                        *(value_pos++) = '\t';
+                        walk++;
+                    } else if (*(walk + 1) == '\\') {
+                        *(value_pos++) = '\\';
+                        walk++;
+                    } else if (*(walk + 1) == 'n') {
+                        *(value_pos++) = '\n';
+                        walk++;
+                    } else if (walk + 3 < end &&
+                            isdigit(*(walk + 1)) && isdigit(*(walk + 2)) && isdigit(*(walk + 3)) &&
+                            *(walk + 1) < '8' && *(walk + 2) < '8' && *(walk + 3) < '8') {
+                        *(value_pos++) = (*(walk + 1) - '0') * 64 + (*(walk + 2) - '0') * 8 + (*(walk + 3) - '0');
+                        walk += 3;
                     } else {
                         *(value_pos++) = *walk;
                     }
+                } else {
+                    /* Everything up to the next escape sequence is copied
+                     * verbatim, so we can skip ahead to it. */
+                    const char *stop = find_chars(walk + 1, end, '\\', '\0', '\0');
+
+                    memcpy(value_pos, walk, stop - walk);
+                    value_pos += stop - walk;
+                    walk = stop - 1;
                 }
 
                 break;
@@ -228,53 +345,144 @@ process_normally:
     }
 
     if (state.chunk == CS_VALUE) {
+        size_t header_size = entry->value - (char *) entry;
+
         *value_pos = '\0';
-        entry->value = strdup(value_buf);
-        if (entry->value == NULL)
-            goto done_error;
+        if (arena != NULL)
+            xcb_xrm_arena_shrink(arena, entry, header_size + value_size, header_size + (value_pos - entry->value + 1));
     } else if (!resource_only) {
         /* Return error if there was no value for this entry. */
         goto done_error;
     } else {
         /* Since in the case of resource_only we never went into CS_VALUE, we
          * need to finalize the last component. */
-        xcb_xrm_finalize_component(entry, &state);
+        xcb_xrm_finalize_component(&state);
+        if ((entry = xcb_xrm_create_entry(&state, 0)) == NULL)
+            goto done_error;
     }
 
     /* Assert that this entry actually had a resource component. */
-    if ((last = TAILQ_LAST(&(entry->components), components_head)) == NULL) {
+    if (entry->num_components == 0) {
         goto done_error;
     }
 
     /* Assert that the last component is not a wildcard. */
-    if (last->type != CT_NORMAL) {
+    if (entry->components[entry->num_components - 1].type != CT_NORMAL) {
         goto done_error;
     }
 
-    FREE(str);
+    xcb_xrm_entry_update_hash(entry);
+    if (state.size_components > ENTRY_STACK_COMPONENTS)
+        FREE(state.components);
+    FREE(state.buffer);
+    *_entry = entry;
     return 0;
 
 done_error:
-    FREE(str);
+    if (state.size_components > ENTRY_STACK_COMPONENTS)
+        FREE(state.components);
+    FREE(state.buffer);
 
-    xcb_xrm_entry_free(entry);
+    /* Memory allocated from an arena is simply left there. */
+    if (arena == NULL)
+        xcb_xrm_entry_free(entry);
     *_entry = NULL;
     return -1;
 }
 
 /*
- * Returns the number of components of the given entry.
+ * Parses a resource name or class into the quarks of its components without
+ * allocating an entry. At most size quarks are stored.
+ *
+ * @return The number of components, which may be larger than size, or a
+ * negative error code if the string is not a valid resource name.
  *
  */
-int xcb_xrm_entry_num_components(xcb_xrm_entry_t *entry) {
-    int result = 0;
+int xcb_xrm_entry_parse_quarks(const char *str, xcb_xrm_quark_t *quarks, int size) {
+    int num = 0;
 
-    xcb_xrm_component_t *current;
-    TAILQ_FOREACH(current, &(entry->components), components) {
-        result++;
+    xcb_xrm_entry_parser_state_t state = {
+        .chunk = CS_COMPONENTS,
+        .current_binding_type = BT_TIGHT,
+        .buffer_size = strlen(str),
+    };
+
+    for (const char *walk = str; ; walk++) {
+        switch (*walk) {
+            case '\0':
+            case '.':
+                if (state.component_len > 0) {
+                    xcb_xrm_quark_t quark = xcb_xrm_quark_intern(state.component, state.component_len, NULL);
+                    if (quark == XCB_XRM_NULLQUARK)
+                        goto done_error;
+
+                    if (num < size)
+                        quarks[num] = quark;
+                    num++;
+                }
+
+                state.component = NULL;
+                state.component_len = 0;
+                state.buffer_pos = NULL;
+
+                if (*walk == '\0')
+                    goto done;
+                break;
+            case ' ':
+            case '\t':
+                /* Just like xcb_xrm_entry_parse, whitespace is skipped. */
+                break;
+            default:
+                if ((*walk != '_' && *walk != '-') &&
+                        (*walk < '0' || *walk > '9') &&
+                        (*walk < 'a' || *walk > 'z') &&
+                        (*walk < 'A' || *walk > 'Z')) {
+                    goto done_error;
+                }
+
+                if (xcb_xrm_append_char(&state, walk) < 0)
+                    goto done_error;
+                break;
+        }
     }
 
-    return result;
+done:
+    FREE(state.buffer);
+    return num == 0 ? -FAILURE : num;
+
+done_error:
+    FREE(state.buffer);
+    return -FAILURE;
+}
+
+/*
+ * Copies the entry into the arena. The position is not copied.
+ *
+ * @return The copy or NULL if memory could not be allocated.
+ *
+ */
+xcb_xrm_entry_t *xcb_xrm_entry_copy(xcb_xrm_entry_t *entry, xcb_xrm_arena_t *arena) {
+    size_t value_size = entry->value == NULL ? 0 : strlen(entry->value) + 1;
+
+    /* Component names are owned by the quark table, so they are shared. */
+    xcb_xrm_entry_t *copy = xcb_xrm_entry_new(arena, entry->num_components, value_size);
+    if (copy == NULL)
+        return NULL;
+
+    memcpy(copy->components, entry->components, entry->num_components * sizeof(xcb_xrm_component_t));
+    if (value_size > 0)
+        memcpy(copy->value, entry->value, value_size);
+    copy->hash = entry->hash;
+
+    return copy;
+}
+
+/*
+ * Returns the number of components of the given entry.
+ *
+ */
+int xcb_xrm_entry_num_components(xcb_xrm_entry_t *entry) {
+    return entry->num_components;
 }
 
 /*
@@ -283,70 +491,115 @@ int xcb_xrm_entry_num_components(xcb_xrm_entry_t *entry) {
  *
  */
 int xcb_xrm_entry_compare(xcb_xrm_entry_t *first, xcb_xrm_entry_t *second) {
-    xcb_xrm_component_t *comp_first = TAILQ_FIRST(&(first->components));
-    xcb_xrm_component_t *comp_second = TAILQ_FIRST(&(second->components));
+    /* Entries with different hashes cannot be equal. */
+    if (first->hash != second->hash || first->num_components != second->num_components)
+        return -FAILURE;
+
+    for (int i = 0; i < first->num_components; i++) {
+        const xcb_xrm_component_t *comp_first = &(first->components[i]);
+        const xcb_xrm_component_t *comp_second = &(second->components[i]);
 
-    while (comp_first != NULL && comp_second != NULL) {
         if (comp_first->type != comp_second->type)
             return -FAILURE;
 
         if (comp_first->binding_type != comp_second->binding_type)
             return -FAILURE;
 
-        if (comp_first->type == CT_NORMAL && strcmp(comp_first->name, comp_second->name) != 0)
+        if (comp_first->type == CT_NORMAL && comp_first->quark != comp_second->quark)
             return -FAILURE;
-
-        comp_first = TAILQ_NEXT(comp_first, components);
-        comp_second = TAILQ_NEXT(comp_second, components);
-    }
-
-    /* At this point, at least one of the two is NULL. If they aren't both
-     * NULL, they have a different number of components and cannot be equal. */
-    if (comp_first != comp_second) {
-        return -FAILURE;
     }
 
     return SUCCESS;
 }
 
 /*
- * Returns a string representation of this entry.
+ * Writes the string representation of this entry to buffer, which must be
+ * large enough, unless it is NULL. If with_value is false, only the resource
+ * specifier is written. The result is not NUL-terminated.
+ *
+ * @return The length of the string representation.
  *
  */
-char *xcb_xrm_entry_to_string(xcb_xrm_entry_t *entry) {
-    char *result = NULL;
-    char *value_buf;
-    char *escaped_value;
-    xcb_xrm_component_t *component;
-    bool is_first = true;
+size_t xcb_xrm_entry_format(xcb_xrm_entry_t *entry, char *buffer, bool with_value) {
+    char *outwalk = buffer;
+    size_t length = 0;
+
+#define APPEND(c)                   \
+    do {                            \
+        if (outwalk != NULL)        \
+            *(outwalk++) = (c);     \
+        length++;                   \
+    } while (0)
 
     assert(entry != NULL);
-    TAILQ_FOREACH(component, &(entry->components), components) {
-        char *tmp;
-        if (asprintf(&tmp, "%s%s%s", result == NULL ? "" : result,
-                (is_first && component->binding_type == BT_TIGHT)
-                    ? ""
-                    : (component->binding_type == BT_TIGHT ? "." : "*"),
-                component->type == CT_NORMAL ? component->name : "?") < 0) {
-            FREE(result);
-            return NULL;
+    for (int i = 0; i < entry->num_components; i++) {
+        const xcb_xrm_component_t *component = &(entry->components[i]);
+
+        if (i > 0 || component->binding_type != BT_TIGHT)
+            APPEND(component->binding_type == BT_TIGHT ? '.' : '*');
+
+        if (component->type == CT_NORMAL) {
+            for (const char *walk = component->name; *walk != '\0'; walk++)
+                APPEND(*walk);
+        } else {
+            APPEND('?');
         }
-        FREE(result);
-        result = tmp;
+    }
+
+    if (!with_value)
+        return length;
 
-        is_first = false;
+    APPEND(':');
+    APPEND(' ');
+
+    /* Escape magic values the same way as xcb_xrm_entry_escape_value. */
+    if (entry->value[0] == ' ' || entry->value[0] == '\t')
+        APPEND('\\');
+    for (const char *walk = entry->value; *walk != '\0'; walk++) {
+        if (*walk == '\n') {
+            APPEND('\\');
+            APPEND('n');
+        } else if (*walk == '\\') {
+            APPEND('\\');
+            APPEND('\\');
+        } else {
+            APPEND(*walk);
+        }
     }
 
-    escaped_value = xcb_xrm_entry_escape_value(entry->value);
-    if (asprintf(&value_buf, "%s: %s", result, escaped_value) < 0) {
-        FREE(escaped_value);
-        FREE(result);
+#undef APPEND
+
+    return length;
+}
+
+/*
+ * Returns a string representation of this entry.
+ *
+ */
+char *xcb_xrm_entry_to_string(xcb_xrm_entry_t *entry) {
+    size_t length = xcb_xrm_entry_format(entry, NULL, true);
+    char *result = malloc(length + 1);
+    if (result == NULL)
         return NULL;
-    }
-    FREE(escaped_value);
-    FREE(result);
-    result = value_buf;
 
+    xcb_xrm_entry_format(entry, result, true);
+    result[length] = '\0';
+    return result;
+}
+
+/*
+ * Returns the resource specifier of an entry, i.e., its string
+ * representation without the value.
+ *
+ */
+char *xcb_xrm_entry_specifier_to_string(xcb_xrm_entry_t *entry) {
+    size_t length = xcb_xrm_entry_format(entry, NULL, false);
+    char *result = malloc(length + 1);
+    if (result == NULL)
+        return NULL;
+
+    xcb_xrm_entry_format(entry, result, false);
+    result[length] = '\0';
     return result;
 }
 
@@ -400,14 +653,7 @@ void xcb_xrm_entry_free(xcb_xrm_entry_t *entry) {
     if (entry == NULL)
         return;
 
-    FREE(entry->value);
-    while (!TAILQ_EMPTY(&(entry->components))) {
-        xcb_xrm_component_t *component = TAILQ_FIRST(&(entry->components));
-        FREE(component->name);
-        TAILQ_REMOVE(&(entry->components), component, components);
-        FREE(component);
-    }
-
+    /* The components and the value are part of the same allocation. */
     FREE(entry);
     return;
 }
@@ -0,0 +1,193 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * Copyright © 2016 Ingo Bürk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the names of the authors or their
+ * institutions shall not be used in advertising or otherwise to promote the
+ * sale, use or other dealings in this Software without prior written
+ * authorization from the authors.
+ *
+ */
+#include "externals.h"
+
+#include "frozen.h"
+#include "util.h"
+
+/* Forward declarations */
+static void __frozen_count(xcb_xrm_node_t *node, int *num_nodes, int *num_edges);
+static int __frozen_add(xcb_xrm_frozen_t *frozen, xcb_xrm_node_t *node);
+static int __frozen_add_edges(xcb_xrm_frozen_t *frozen, xcb_xrm_node_table_t *table, int *count);
+static int __frozen_compare_edges(const void *first, const void *second);
+
+/*
+ * Compiles the index below root. Returns NULL if memory could not be
+ * allocated.
+ *
+ */
+xcb_xrm_frozen_t *xcb_xrm_frozen_new(xcb_xrm_node_t *root) {
+    int num_nodes = 0;
+    int num_edges = 0;
+
+    xcb_xrm_frozen_t *frozen = calloc(1, sizeof(struct xcb_xrm_frozen_t));
+    if (frozen == NULL)
+        return NULL;
+
+    /* Size both arrays up front so that they never have to be moved while we
+     * fill them. */
+    __frozen_count(root, &num_nodes, &num_edges);
+
+    frozen->nodes = calloc(num_nodes, sizeof(xcb_xrm_frozen_node_t));
+    frozen->edges = calloc(MAX(num_edges, 1), sizeof(xcb_xrm_frozen_edge_t));
+    if (frozen->nodes == NULL || frozen->edges == NULL) {
+        xcb_xrm_frozen_free(frozen);
+        return NULL;
+    }
+
+    __frozen_add(frozen, root);
+    assert(frozen->num_nodes == num_nodes && frozen->num_edges == num_edges);
+
+    return frozen;
+}
+
+/*
+ * Returns the index of the child among the count edges starting at first
+ * for the given quark or FROZEN_NONE if there is no such child. filter is the
+ * filter of the edges as in xcb_xrm_node_table_t.
+ *
+ */
+int xcb_xrm_frozen_lookup(const xcb_xrm_frozen_t *frozen, int first, int count, uint64_t filter,
+        xcb_xrm_quark_t quark) {
+    const xcb_xrm_frozen_edge_t *edges = frozen->edges + first;
+    int low = 0;
+    int high = count;
+
+    if (!(filter & NODE_FILTER_BIT(quark)))
+        return FROZEN_NONE;
+
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+
+        if (edges[middle].quark == quark)
+            return edges[middle].node;
+
+        if (edges[middle].quark < quark)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return FROZEN_NONE;
+}
+
+/*
+ * Frees the given frozen index.
+ *
+ */
+void xcb_xrm_frozen_free(xcb_xrm_frozen_t *frozen) {
+    if (frozen == NULL)
+        return;
+
+    FREE(frozen->nodes);
+    FREE(frozen->edges);
+    FREE(frozen);
+}
+
+static void __frozen_count(xcb_xrm_node_t *node, int *num_nodes, int *num_edges) {
+    xcb_xrm_node_table_t *tables[] = { &(node->tight), &(node->loose) };
+
+    (*num_nodes)++;
+
+    for (size_t t = 0; t < sizeof(tables) / sizeof(tables[0]); t++) {
+        for (size_t i = 0; i < tables[t]->size; i++) {
+            if (tables[t]->slots[i] == NULL)
+                continue;
+
+            (*num_edges)++;
+            __frozen_count(tables[t]->slots[i], num_nodes, num_edges);
+        }
+    }
+
+    if (node->tight_wildcard != NULL)
+        __frozen_count(node->tight_wildcard, num_nodes, num_edges);
+    if (node->loose_wildcard != NULL)
+        __frozen_count(node->loose_wildcard, num_nodes, num_edges);
+}
+
+/* Appends node and its descendants and returns the index of node. */
+static int __frozen_add(xcb_xrm_frozen_t *frozen, xcb_xrm_node_t *node) {
+    int index = frozen->num_nodes++;
+    xcb_xrm_frozen_node_t *frozen_node = &(frozen->nodes[index]);
+
+    frozen_node->entry = node->entry;
+    frozen_node->tight = __frozen_add_edges(frozen, &(node->tight), &(frozen_node->num_tight));
+    frozen_node->loose = __frozen_add_edges(frozen, &(node->loose), &(frozen_node->num_loose));
+    frozen_node->tight_filter = node->tight.filter;
+    frozen_node->loose_filter = node->loose.filter;
+    frozen_node->tight_wildcard = FROZEN_NONE;
+    frozen_node->loose_wildcard = FROZEN_NONE;
+
+    for (int i = 0; i < frozen_node->num_tight; i++) {
+        xcb_xrm_frozen_edge_t *edge = &(frozen->edges[frozen_node->tight + i]);
+        edge->node = __frozen_add(frozen, xcb_xrm_node_lookup(&(node->tight), edge->quark));
+    }
+
+    for (int i = 0; i < frozen_node->num_loose; i++) {
+        xcb_xrm_frozen_edge_t *edge = &(frozen->edges[frozen_node->loose + i]);
+        edge->node = __frozen_add(frozen, xcb_xrm_node_lookup(&(node->loose), edge->quark));
+    }
+
+    if (node->tight_wildcard != NULL)
+        frozen_node->tight_wildcard = __frozen_add(frozen, node->tight_wildcard);
+    if (node->loose_wildcard != NULL)
+        frozen_node->loose_wildcard = __frozen_add(frozen, node->loose_wildcard);
+
+    return index;
+}
+
+/* Reserves the edges for the children in table, sorted by quark, and returns
+ * the index of the first one. */
+static int __frozen_add_edges(xcb_xrm_frozen_t *frozen, xcb_xrm_node_table_t *table, int *count) {
+    int first = frozen->num_edges;
+
+    for (size_t i = 0; i < table->size; i++) {
+        if (table->slots[i] == NULL)
+            continue;
+
+        frozen->edges[frozen->num_edges++] = (xcb_xrm_frozen_edge_t) {
+            .quark = table->slots[i]->quark,
+            .node = FROZEN_NONE,
+        };
+    }
+
+    *count = frozen->num_edges - first;
+    qsort(frozen->edges + first, *count, sizeof(xcb_xrm_frozen_edge_t), __frozen_compare_edges);
+    return first;
+}
+
+static int __frozen_compare_edges(const void *first, const void *second) {
+    const xcb_xrm_frozen_edge_t *edge_first = first;
+    const xcb_xrm_frozen_edge_t *edge_second = second;
+
+    if (edge_first->quark < edge_second->quark)
+        return -1;
+
+    return edge_first->quark > edge_second->quark;
+}
@@ -0,0 +1,179 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * Copyright © 2016 Ingo Bürk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the names of the authors or their
+ * institutions shall not be used in advertising or otherwise to promote the
+ * sale, use or other dealings in this Software without prior written
+ * authorization from the authors.
+ *
+ */
+#include "externals.h"
+
+#include "lazy.h"
+#include "util.h"
+
+/* Forward declarations */
+static xcb_xrm_lazy_bucket_t *__lazy_slot(xcb_xrm_lazy_bucket_t *buckets, size_t size, xcb_xrm_quark_t quark);
+static int __lazy_grow_buckets(xcb_xrm_lazy_t *lazy);
+static int __lazy_reserve_buffer(xcb_xrm_lazy_t *lazy, size_t len);
+
+/*
+ * Creates an empty set of deferred lines.
+ *
+ * @return The set or NULL if memory could not be allocated.
+ *
+ */
+xcb_xrm_lazy_t *xcb_xrm_lazy_new(void) {
+    return calloc(1, sizeof(xcb_xrm_lazy_t));
+}
+
+/*
+ * Defers the first len bytes of line, which must not contain any line
+ * continuations, to be parsed once a query for the given first component is
+ * resolved. Lines must be added in the order of their positions.
+ *
+ * @return 0 on success, a negative error code otherwise.
+ *
+ */
+int xcb_xrm_lazy_add(xcb_xrm_lazy_t *lazy, xcb_xrm_quark_t quark, const char *line, size_t len,
+        unsigned long position) {
+    xcb_xrm_lazy_bucket_t *bucket;
+
+    /* Keep the load factor of the table below 3/4. */
+    if (4 * (lazy->num_buckets + 1) > 3 * lazy->size_buckets && __lazy_grow_buckets(lazy) < 0)
+        return -FAILURE;
+
+    if (__lazy_reserve_buffer(lazy, len) < 0)
+        return -FAILURE;
+
+    bucket = __lazy_slot(lazy->buckets, lazy->size_buckets, quark);
+    if (bucket->num_lines == bucket->size_lines) {
+        size_t new_size = MAX(4, 2 * bucket->size_lines);
+        xcb_xrm_lazy_line_t *new_lines = realloc(bucket->lines, new_size * sizeof(xcb_xrm_lazy_line_t));
+        if (new_lines == NULL)
+            return -FAILURE;
+
+        bucket->lines = new_lines;
+        bucket->size_lines = new_size;
+    }
+
+    if (bucket->quark == XCB_XRM_NULLQUARK) {
+        bucket->quark = quark;
+        lazy->num_buckets++;
+    }
+
+    memcpy(lazy->buffer + lazy->length, line, len);
+    bucket->lines[bucket->num_lines++] = (xcb_xrm_lazy_line_t) { lazy->length, len, position };
+    lazy->length += len;
+    lazy->num_lines++;
+    return SUCCESS;
+}
+
+/*
+ * Returns the bucket of lines with the given first component or NULL if
+ * there is none. The lines stay valid until they are released with
+ * @ref xcb_xrm_lazy_release.
+ *
+ */
+xcb_xrm_lazy_bucket_t *xcb_xrm_lazy_find(xcb_xrm_lazy_t *lazy, xcb_xrm_quark_t quark) {
+    xcb_xrm_lazy_bucket_t *bucket;
+
+    if (lazy->size_buckets == 0 || quark == XCB_XRM_NULLQUARK)
+        return NULL;
+
+    bucket = __lazy_slot(lazy->buckets, lazy->size_buckets, quark);
+    return bucket->num_lines == 0 ? NULL : bucket;
+}
+
+/*
+ * Removes all lines from the bucket once they have been parsed.
+ *
+ */
+void xcb_xrm_lazy_release(xcb_xrm_lazy_t *lazy, xcb_xrm_lazy_bucket_t *bucket) {
+    lazy->num_lines -= bucket->num_lines;
+    FREE(bucket->lines);
+    bucket->num_lines = 0;
+    bucket->size_lines = 0;
+}
+
+/*
+ * Frees the given set of deferred lines.
+ *
+ */
+void xcb_xrm_lazy_free(xcb_xrm_lazy_t *lazy) {
+    if (lazy == NULL)
+        return;
+
+    for (size_t i = 0; i < lazy->size_buckets; i++)
+        FREE(lazy->buckets[i].lines);
+
+    FREE(lazy->buckets);
+    FREE(lazy->buffer);
+    FREE(lazy);
+}
+
+/* Returns the bucket for the given quark or the empty slot where it has to be
+ * inserted. There must be at least one empty slot. */
+static xcb_xrm_lazy_bucket_t *__lazy_slot(xcb_xrm_lazy_bucket_t *buckets, size_t size, xcb_xrm_quark_t quark) {
+    size_t mask = size - 1;
+    /* Quarks are handed out sequentially, so scatter them a bit. */
+    size_t i = ((uint32_t) quark * 2654435761u) & mask;
+
+    while (buckets[i].quark != XCB_XRM_NULLQUARK && buckets[i].quark != quark)
+        i = (i + 1) & mask;
+
+    return &(buckets[i]);
+}
+
+static int __lazy_grow_buckets(xcb_xrm_lazy_t *lazy) {
+    size_t new_size = MAX(16, 2 * lazy->size_buckets);
+    xcb_xrm_lazy_bucket_t *new_buckets = calloc(new_size, sizeof(xcb_xrm_lazy_bucket_t));
+    if (new_buckets == NULL)
+        return -FAILURE;
+
+    for (size_t i = 0; i < lazy->size_buckets; i++) {
+        if (lazy->buckets[i].quark != XCB_XRM_NULLQUARK)
+            *__lazy_slot(new_buckets, new_size, lazy->buckets[i].quark) = lazy->buckets[i];
+    }
+
+    FREE(lazy->buckets);
+    lazy->buckets = new_buckets;
+    lazy->size_buckets = new_size;
+    return SUCCESS;
+}
+
+static int __lazy_reserve_buffer(xcb_xrm_lazy_t *lazy, size_t len) {
+    size_t new_size;
+    char *new_buffer;
+
+    if (lazy->length + len <= lazy->size)
+        return SUCCESS;
+
+    new_size = MAX(MAX(4096, 2 * lazy->size), lazy->length + len);
+    new_buffer = realloc(lazy->buffer, new_size);
+    if (new_buffer == NULL)
+        return -FAILURE;
+
+    lazy->buffer = new_buffer;
+    lazy->size = new_size;
+    return SUCCESS;
+}
@@ -31,12 +31,62 @@
 #include "match.h"
 #include "util.h"
 
+/* Queries with up to this many components and lookups with up to this many
+ * candidates are matched without allocating any memory. */
+#define MATCH_STACK_DEPTH 16
+#define MATCH_STACK_CANDIDATES 16
+
+/* State of a single descent through the database index. */
+typedef struct xcb_xrm_match_state_t {
+    /* The number of components of the query. */
+    int length;
+    /* The quarks of the name query's components. */
+    const xcb_xrm_quark_t *names;
+    /* The quarks of the class query's components or NULL if no class query
+     * was given. */
+    const xcb_xrm_quark_t *classes;
+    /* How each component was matched on the current path. */
+    xcb_xrm_match_flags_t *flags;
+
+    /* The matching entries which have been found. The flags of the i-th
+     * candidate are stored at candidate_flags[i * length]. */
+    xcb_xrm_match_t *candidates;
+    xcb_xrm_match_flags_t *candidate_flags;
+    int num_candidates;
+    int size_candidates;
+
+    /* The storage for the candidates as long as it is large enough. */
+    xcb_xrm_match_t stack_candidates[MATCH_STACK_CANDIDATES];
+    xcb_xrm_match_flags_t stack_flags[MATCH_STACK_CANDIDATES * MATCH_STACK_DEPTH];
+
+    /* If not NULL, the query is only a prefix and the descent records where
+     * it stopped in the frontier instead of collecting entries. */
+    xcb_xrm_match_frontier_t *frontier;
+
+    /* The frozen index if the database has been frozen. */
+    const xcb_xrm_frozen_t *frozen;
+} xcb_xrm_match_state_t;
+
 /* Forward declarations */
-static int __match_matches(xcb_xrm_entry_t *db_entry, xcb_xrm_entry_t *query_name, xcb_xrm_entry_t *query_class,
-        xcb_xrm_match_t *match);
+static void __match_descend(xcb_xrm_match_state_t *state, xcb_xrm_node_t *node, int level);
+static void __match_descend_loose(xcb_xrm_match_state_t *state, xcb_xrm_node_t *node, int level, int start);
+static void __match_descend_frozen(xcb_xrm_match_state_t *state, int index, int level);
+static void __match_descend_loose_frozen(xcb_xrm_match_state_t *state, int index, int level, int start);
+static void __match_add_candidate(xcb_xrm_match_state_t *state, xcb_xrm_entry_t *entry);
+static int __match_grow_candidates(xcb_xrm_match_state_t *state);
+static void __match_add_frontier_item(xcb_xrm_match_state_t *state, xcb_xrm_node_t *node, int index, int level,
+        bool loose);
+static void __match_frontier_descend(xcb_xrm_match_frontier_t *frontier, const xcb_xrm_frozen_t *frozen);
+static int __match_pick(xcb_xrm_match_state_t *state, xcb_xrm_resource_t *resource);
+static int __match_reserve(xcb_xrm_match_frontier_t *frontier, int length);
+static int __match_compare_positions(const void *first, const void *second);
 static int __match_compare(int length, xcb_xrm_match_t *best, xcb_xrm_match_t *candidate);
-static xcb_xrm_match_t *__match_new(int length);
-static void __match_free(xcb_xrm_match_t *match);
+static xcb_xrm_quark_t *__match_quarks(xcb_xrm_entry_t *query, int length);
+static void __match_load(xcb_xrm_database_t *database, const xcb_xrm_quark_t *names,
+        const xcb_xrm_quark_t *classes, int length);
+static void __match_record(xcb_xrm_database_t *database, const xcb_xrm_quark_t *names,
+        const xcb_xrm_quark_t *classes, int length, int num_candidates, uint64_t start);
+static char *__match_join(const xcb_xrm_quark_t *quarks, int length);
 
 /*
  * Finds the matching entry in the database given a full name / class query string.
@@ -44,125 +94,557 @@ static void __match_free(xcb_xrm_match_t *match);
  */
 int xcb_xrm_match(xcb_xrm_database_t *database, xcb_xrm_entry_t *query_name, xcb_xrm_entry_t *query_class,
         xcb_xrm_resource_t *resource) {
-    xcb_xrm_match_t *best_match = NULL;
-    xcb_xrm_entry_t *cur_entry = TAILQ_FIRST(database);
+    xcb_xrm_quark_t *names;
+    xcb_xrm_quark_t *classes = NULL;
+    int result = -FAILURE;
 
     /* Let's figure out how many elements we need to store. */
     int num = xcb_xrm_entry_num_components(query_name);
 
-    while (cur_entry != NULL) {
-        xcb_xrm_match_t *cur_match = __match_new(num);
-        if (cur_match == NULL)
+    names = __match_quarks(query_name, num);
+    if (names == NULL)
+        goto done;
+
+    if (query_class != NULL && (classes = __match_quarks(query_class, num)) == NULL)
+        goto done;
+
+    result = xcb_xrm_match_quarks(database, names, classes, num, resource);
+
+done:
+    FREE(names);
+    FREE(classes);
+    return result;
+}
+
+/*
+ * Finds the matching entry in the database given the quarks of the name and
+ * class query components.
+ *
+ */
+int xcb_xrm_match_quarks(xcb_xrm_database_t *database, const xcb_xrm_quark_t *names,
+        const xcb_xrm_quark_t *classes, int length, xcb_xrm_resource_t *resource) {
+    int result = -FAILURE;
+    int num_candidates;
+    uint64_t start = database->trace != NULL ? get_time() : 0;
+    xcb_xrm_match_flags_t stack_flags[MATCH_STACK_DEPTH];
+    xcb_xrm_match_state_t state;
+
+    /* Only the small part of the state which is not scratch space needs to
+     * be initialized. */
+    state.length = length;
+    state.names = names;
+    state.classes = classes;
+    state.flags = stack_flags;
+    state.candidates = NULL;
+    state.candidate_flags = NULL;
+    state.num_candidates = 0;
+    state.size_candidates = 0;
+    state.frontier = NULL;
+
+    if (length > MATCH_STACK_DEPTH) {
+        state.flags = calloc(length, sizeof(xcb_xrm_match_flags_t));
+        if (state.flags == NULL)
             return -FAILURE;
+    }
+
+    /* Collect all entries matching the query. */
+    __match_load(database, names, classes, length);
+    state.frozen = xcb_xrm_database_read_begin(database);
+    if (state.frozen != NULL)
+        __match_descend_frozen(&state, 0, 0);
+    else
+        __match_descend(&state, database->root, 0);
+    num_candidates = state.num_candidates;
+    result = __match_pick(&state, resource);
+    xcb_xrm_database_read_end(database);
+
+    if (state.flags != stack_flags)
+        FREE(state.flags);
+    __match_record(database, names, classes, length, num_candidates, start);
+    return result;
+}
+
+/*
+ * Matches the given query prefix against the database and stores the state of
+ * the descent in frontier.
+ *
+ */
+int xcb_xrm_match_frontier_init(xcb_xrm_database_t *database, xcb_xrm_match_frontier_t *frontier,
+        const xcb_xrm_quark_t *names, const xcb_xrm_quark_t *classes, int length) {
+    memset(frontier, 0, sizeof(xcb_xrm_match_frontier_t));
+    frontier->database = database;
+    frontier->length = length;
+    /* Without any prefix components, the frontier does not depend on the
+     * class, so we can use it for queries with and without a class. */
+    frontier->with_classes = classes != NULL || length == 0;
+
+    if (__match_reserve(frontier, length + 1) < 0)
+        goto fail;
+
+    if (length > 0) {
+        memcpy(frontier->names, names, length * sizeof(xcb_xrm_quark_t));
+        if (classes != NULL)
+            memcpy(frontier->classes, classes, length * sizeof(xcb_xrm_quark_t));
+    }
+
+    __match_load(database, names, classes, length);
+
+    /* Other threads may modify the index of a concurrent database at any
+     * time, so the prefix is matched against the published frozen index. */
+    if (database->concurrent) {
+        __match_frontier_descend(frontier, xcb_xrm_database_read_begin(database));
+        xcb_xrm_database_read_end(database);
+    } else {
+        __match_frontier_descend(frontier, NULL);
+    }
+
+    return SUCCESS;
+
+fail:
+    xcb_xrm_match_frontier_free(frontier);
+    return -FAILURE;
+}
+
+/*
+ * Finds the matching entry in the database for the query consisting of the
+ * frontier's prefix followed by the given components.
+ *
+ */
+int xcb_xrm_match_frontier_resolve(xcb_xrm_match_frontier_t *frontier, const xcb_xrm_quark_t *names,
+        const xcb_xrm_quark_t *classes, int length, xcb_xrm_resource_t *resource) {
+    xcb_xrm_database_t *database = frontier->database;
+    int full_length = frontier->length + length;
+    const xcb_xrm_frozen_t *frozen = NULL;
+    xcb_xrm_match_state_t state;
+    uint64_t start;
+    int num_candidates;
+    int result;
+
+    if (length == 0 || (classes != NULL && !frontier->with_classes))
+        return -FAILURE;
+
+    if (__match_reserve(frontier, full_length) < 0)
+        return -FAILURE;
+
+    memcpy(frontier->names + frontier->length, names, length * sizeof(xcb_xrm_quark_t));
+    if (classes != NULL)
+        memcpy(frontier->classes + frontier->length, classes, length * sizeof(xcb_xrm_quark_t));
+
+    /* The prefix has been matched including the class components, which we
+     * must not use for a query without a class. */
+    if (classes == NULL && frontier->with_classes && frontier->length > 0)
+        return xcb_xrm_match_quarks(frontier->database, frontier->names, NULL, full_length, resource);
+
+    /* Without any prefix components, the query's first component is only
+     * known now. */
+    if (frontier->length == 0)
+        __match_load(database, names, classes, length);
+
+    /* If a modification has published a new frozen index since the prefix
+     * was matched, the items refer to the old one, which might have been
+     * free'd already. */
+    if (database->concurrent) {
+        frozen = xcb_xrm_database_read_begin(database);
+        if (frozen != frontier->frozen || frozen->generation != frontier->generation)
+            __match_frontier_descend(frontier, frozen);
+    }
+
+    start = database->trace != NULL ? get_time() : 0;
+    state.length = full_length;
+    state.names = frontier->names;
+    state.classes = classes == NULL ? NULL : frontier->classes;
+    state.flags = frontier->flags;
+    state.candidates = NULL;
+    state.candidate_flags = NULL;
+    state.num_candidates = 0;
+    state.size_candidates = 0;
+    state.frontier = NULL;
+    state.frozen = frozen;
+
+    /* Continue each path through the index from where the prefix left it. */
+    for (int i = 0; i < frontier->num_items; i++) {
+        xcb_xrm_match_frontier_item_t *item = &(frontier->items[i]);
+
+        memcpy(state.flags, item->flags, item->level * sizeof(xcb_xrm_match_flags_t));
+        if (frozen != NULL && item->loose)
+            __match_descend_loose_frozen(&state, item->index, item->level, frontier->length);
+        else if (frozen != NULL)
+            __match_descend_frozen(&state, item->index, item->level);
+        else if (item->loose)
+            __match_descend_loose(&state, item->node, item->level, frontier->length);
+        else
+            __match_descend(&state, item->node, item->level);
+    }
+
+    num_candidates = state.num_candidates;
+    result = __match_pick(&state, resource);
+    if (database->concurrent)
+        xcb_xrm_database_read_end(database);
+    __match_record(database, state.names, state.classes, full_length, num_candidates, start);
+    return result;
+}
 
-        /* First we check whether the current database entry even matches. */
-        if (__match_matches(cur_entry, query_name, query_class, cur_match) == 0) {
-            /* The first matching entry is the first one we pick as the best matching entry. */
-            if (best_match == NULL) {
-                best_match = cur_match;
-            } else {
-                /* Otherwise, check whether this match is better than the current best. */
-                if (__match_compare(num, best_match, cur_match) == 0) {
-                    __match_free(best_match);
-                    best_match = cur_match;
-                } else {
-                    __match_free(cur_match);
-                }
+/*
+ * Frees the state stored in frontier.
+ *
+ */
+void xcb_xrm_match_frontier_free(xcb_xrm_match_frontier_t *frontier) {
+    for (int i = 0; i < frontier->num_items; i++)
+        FREE(frontier->items[i].flags);
+    FREE(frontier->items);
+    frontier->frozen = NULL;
+    FREE(frontier->names);
+    FREE(frontier->classes);
+    FREE(frontier->flags);
+    frontier->num_items = 0;
+    frontier->size_items = 0;
+    frontier->size_query = 0;
+}
+
+/* Finds all entries below node which match the query from the given level on.
+ * This follows the same rules as matching a single entry component by
+ * component: a normal component must match the name (which is preferred) or
+ * the class of the query component, a wildcard matches any query component and
+ * a loose binding skips query components until the first one which matches. */
+static void __match_descend(xcb_xrm_match_state_t *state, xcb_xrm_node_t *node, int level) {
+    xcb_xrm_node_t *child;
+
+    if (level == state->length) {
+        if (state->frontier != NULL)
+            __match_add_frontier_item(state, node, FROZEN_NONE, level, false);
+        else if (node->entry != NULL)
+            __match_add_candidate(state, node->entry);
+        return;
+    }
+
+    if ((child = xcb_xrm_node_lookup(&(node->tight), state->names[level])) != NULL) {
+        state->flags[level] = MF_NAME;
+        __match_descend(state, child, level + 1);
+    }
+
+    if (state->classes != NULL && state->classes[level] != state->names[level] &&
+            (child = xcb_xrm_node_lookup(&(node->tight), state->classes[level])) != NULL) {
+        state->flags[level] = MF_CLASS;
+        __match_descend(state, child, level + 1);
+    }
+
+    if (node->tight_wildcard != NULL) {
+        state->flags[level] = MF_WILDCARD;
+        __match_descend(state, node->tight_wildcard, level + 1);
+    }
+
+    if (node->loose_wildcard != NULL) {
+        state->flags[level] = MF_PRECEDING_LOOSE | MF_WILDCARD;
+        __match_descend(state, node->loose_wildcard, level + 1);
+    }
+
+    if (node->loose.count > 0) {
+        __match_descend_loose(state, node, level, level);
+
+        /* The loosely bound children might also match a component after the
+         * prefix, so we need to come back to them. */
+        if (state->frontier != NULL)
+            __match_add_frontier_item(state, node, FROZEN_NONE, level, true);
+    }
+}
+
+/* Handles the loosely bound normal children of node. Such a component matches
+ * the first query component from level on whose name or class equals it.
+ * Only matches from start on are considered; the query components between
+ * level and start must have been handled already. */
+static void __match_descend_loose(xcb_xrm_match_state_t *state, xcb_xrm_node_t *node, int level, int start) {
+    for (int i = start; i < state->length; i++) {
+        for (int use_class = 0; use_class <= 1; use_class++) {
+            xcb_xrm_quark_t quark;
+            xcb_xrm_node_t *child;
+            bool seen = false;
+
+            if (use_class && (state->classes == NULL || state->classes[i] == state->names[i]))
+                continue;
+
+            quark = use_class ? state->classes[i] : state->names[i];
+            if ((child = xcb_xrm_node_lookup(&(node->loose), quark)) == NULL)
+                continue;
+
+            /* If the component already matched an earlier query component,
+             * it has been handled there. */
+            for (int j = level; j < i && !seen; j++) {
+                seen = state->names[j] == quark ||
+                    (state->classes != NULL && state->classes[j] == quark);
             }
-        } else {
-            __match_free(cur_match);
+            if (seen)
+                continue;
+
+            for (int j = level; j < i; j++)
+                state->flags[j] = MF_SKIPPED;
+            state->flags[i] = MF_PRECEDING_LOOSE | (use_class ? MF_CLASS : MF_NAME);
+            __match_descend(state, child, i + 1);
         }
+    }
+}
 
-        /* Advance to the next database entry. */
-        cur_entry = TAILQ_NEXT(cur_entry, entries);
+/* The same as __match_descend, but for the frozen index. */
+static void __match_descend_frozen(xcb_xrm_match_state_t *state, int index, int level) {
+    const xcb_xrm_frozen_node_t *node = &(state->frozen->nodes[index]);
+    int child;
+
+    if (level == state->length) {
+        if (state->frontier != NULL)
+            __match_add_frontier_item(state, NULL, index, level, false);
+        else if (node->entry != NULL)
+            __match_add_candidate(state, node->entry);
+        return;
     }
 
-    if (best_match != NULL) {
-        resource->value = strdup(best_match->entry->value);
-        if (resource->value == NULL) {
-            __match_free(best_match);
-            return -FAILURE;
+    if ((child = xcb_xrm_frozen_lookup(state->frozen, node->tight, node->num_tight, node->tight_filter,
+                    state->names[level])) != FROZEN_NONE) {
+        state->flags[level] = MF_NAME;
+        __match_descend_frozen(state, child, level + 1);
+    }
+
+    if (state->classes != NULL && state->classes[level] != state->names[level] &&
+            (child = xcb_xrm_frozen_lookup(state->frozen, node->tight, node->num_tight, node->tight_filter,
+                    state->classes[level])) != FROZEN_NONE) {
+        state->flags[level] = MF_CLASS;
+        __match_descend_frozen(state, child, level + 1);
+    }
+
+    if (node->tight_wildcard != FROZEN_NONE) {
+        state->flags[level] = MF_WILDCARD;
+        __match_descend_frozen(state, node->tight_wildcard, level + 1);
+    }
+
+    if (node->loose_wildcard != FROZEN_NONE) {
+        state->flags[level] = MF_PRECEDING_LOOSE | MF_WILDCARD;
+        __match_descend_frozen(state, node->loose_wildcard, level + 1);
+    }
+
+    if (node->num_loose > 0) {
+        __match_descend_loose_frozen(state, index, level, level);
+
+        if (state->frontier != NULL)
+            __match_add_frontier_item(state, NULL, index, level, true);
+    }
+}
+
+/* The same as __match_descend_loose, but for the frozen index. */
+static void __match_descend_loose_frozen(xcb_xrm_match_state_t *state, int index, int level, int start) {
+    const xcb_xrm_frozen_node_t *node = &(state->frozen->nodes[index]);
+
+    for (int i = start; i < state->length; i++) {
+        for (int use_class = 0; use_class <= 1; use_class++) {
+            xcb_xrm_quark_t quark;
+            int child;
+            bool seen = false;
+
+            if (use_class && (state->classes == NULL || state->classes[i] == state->names[i]))
+                continue;
+
+            quark = use_class ? state->classes[i] : state->names[i];
+            child = xcb_xrm_frozen_lookup(state->frozen, node->loose, node->num_loose, node->loose_filter,
+                    quark);
+            if (child == FROZEN_NONE)
+                continue;
+
+            for (int j = level; j < i && !seen; j++) {
+                seen = state->names[j] == quark ||
+                    (state->classes != NULL && state->classes[j] == quark);
+            }
+            if (seen)
+                continue;
+
+            for (int j = level; j < i; j++)
+                state->flags[j] = MF_SKIPPED;
+            state->flags[i] = MF_PRECEDING_LOOSE | (use_class ? MF_CLASS : MF_NAME);
+            __match_descend_frozen(state, child, i + 1);
         }
+    }
+}
+
+static void __match_add_candidate(xcb_xrm_match_state_t *state, xcb_xrm_entry_t *entry) {
+    if (state->num_candidates == state->size_candidates && __match_grow_candidates(state) < 0)
+        return;
+
+    state->candidates[state->num_candidates].entry = entry;
+    memcpy(state->candidate_flags + state->num_candidates * state->length, state->flags,
+            state->length * sizeof(xcb_xrm_match_flags_t));
+    state->num_candidates++;
+}
 
-        __match_free(best_match);
+/* Makes room for more candidates. The stack storage is used first, and only
+ * lookups with many candidates or long queries move them to the heap. */
+static int __match_grow_candidates(xcb_xrm_match_state_t *state) {
+    int new_size;
+    xcb_xrm_match_t *new_candidates;
+    xcb_xrm_match_flags_t *new_flags;
+
+    if (state->candidates == NULL && state->length <= MATCH_STACK_DEPTH) {
+        state->candidates = state->stack_candidates;
+        state->candidate_flags = state->stack_flags;
+        state->size_candidates = MATCH_STACK_CANDIDATES;
         return SUCCESS;
     }
 
-    return -FAILURE;
+    new_size = MAX(4, 2 * state->size_candidates);
+    new_candidates = malloc(new_size * sizeof(xcb_xrm_match_t));
+    new_flags = malloc(MAX(new_size * state->length, 1) * sizeof(xcb_xrm_match_flags_t));
+    if (new_candidates == NULL || new_flags == NULL) {
+        FREE(new_candidates);
+        FREE(new_flags);
+        return -FAILURE;
+    }
+
+    if (state->num_candidates > 0) {
+        memcpy(new_candidates, state->candidates, state->num_candidates * sizeof(xcb_xrm_match_t));
+        memcpy(new_flags, state->candidate_flags,
+                state->num_candidates * state->length * sizeof(xcb_xrm_match_flags_t));
+    }
+
+    if (state->candidates != state->stack_candidates) {
+        FREE(state->candidates);
+        FREE(state->candidate_flags);
+    }
+
+    state->candidates = new_candidates;
+    state->candidate_flags = new_flags;
+    state->size_candidates = new_size;
+    return SUCCESS;
 }
 
-static int __match_matches(xcb_xrm_entry_t *db_entry, xcb_xrm_entry_t *query_name, xcb_xrm_entry_t *query_class,
-        xcb_xrm_match_t *match) {
-    /* We need to deal with an absent query_class since many applications don't
-     * pass one, even though that violates the specification. */
-    bool use_class = (query_class != NULL);
-
-    xcb_xrm_component_t *cur_comp_name = TAILQ_FIRST(&(query_name->components));
-    xcb_xrm_component_t *cur_comp_class = use_class ? TAILQ_FIRST(&(query_class->components)) : NULL;
-    xcb_xrm_component_t *cur_comp_db = TAILQ_FIRST(&(db_entry->components));
-
-#define ADVANCE(entry) do {                      \
-    if (entry != NULL)                           \
-        entry = TAILQ_NEXT((entry), components); \
-} while (0)
-
-    int i = 0;
-    while (cur_comp_name != NULL && (!use_class || cur_comp_class) && cur_comp_db != NULL) {
-        if (cur_comp_db->binding_type == BT_LOOSE)
-            match->flags[i] = MF_PRECEDING_LOOSE;
-
-        switch (cur_comp_db->type) {
-            case CT_NORMAL:
-                if (strcmp(cur_comp_db->name, cur_comp_name->name) == 0) {
-                    match->flags[i++] |= MF_NAME;
-
-                    ADVANCE(cur_comp_db);
-                    ADVANCE(cur_comp_name);
-                    ADVANCE(cur_comp_class);
-                } else if (use_class && strcmp(cur_comp_db->name, cur_comp_class->name) == 0) {
-                    match->flags[i++] |= MF_CLASS;
-
-                    ADVANCE(cur_comp_db);
-                    ADVANCE(cur_comp_name);
-                    ADVANCE(cur_comp_class);
-                } else {
-                    if (cur_comp_db->binding_type == BT_TIGHT) {
-                        return -FAILURE;
-                    } else {
-                        /* We remove this flag again because we need to apply
-                         * it to the last component in the matching chain for
-                         * the loose binding. */
-                        match->flags[i] &= ~MF_PRECEDING_LOOSE;
-                        match->flags[i++] |= MF_SKIPPED;
-
-                        ADVANCE(cur_comp_name);
-                        ADVANCE(cur_comp_class);
-                    }
-                }
-
-                break;
-            case CT_WILDCARD:
-                match->flags[i++] |= MF_WILDCARD;
-
-                ADVANCE(cur_comp_db);
-                ADVANCE(cur_comp_name);
-                ADVANCE(cur_comp_class);
-
-                break;
-            default:
-                /* Never reached. */
-                return -FAILURE;
-        }
+static void __match_add_frontier_item(xcb_xrm_match_state_t *state, xcb_xrm_node_t *node, int index, int level,
+        bool loose) {
+    xcb_xrm_match_frontier_t *frontier = state->frontier;
+    xcb_xrm_match_frontier_item_t *item;
+
+    if (frontier->num_items == frontier->size_items) {
+        int new_size = MAX(4, 2 * frontier->size_items);
+        xcb_xrm_match_frontier_item_t *new_items = realloc(frontier->items,
+                new_size * sizeof(xcb_xrm_match_frontier_item_t));
+        if (new_items == NULL)
+            return;
+
+        frontier->items = new_items;
+        frontier->size_items = new_size;
     }
 
-#undef ADVANCE
+    item = &(frontier->items[frontier->num_items]);
+    item->node = node;
+    item->index = index;
+    item->level = level;
+    item->loose = loose;
+    item->flags = malloc(MAX(level, 1) * sizeof(xcb_xrm_match_flags_t));
+    if (item->flags == NULL)
+        return;
+
+    memcpy(item->flags, state->flags, level * sizeof(xcb_xrm_match_flags_t));
+    frontier->num_items++;
+}
+
+/* Matches the prefix of the frontier against the index of its database or, if
+ * it is not NULL, against the given frozen index, replacing all items. */
+static void __match_frontier_descend(xcb_xrm_match_frontier_t *frontier, const xcb_xrm_frozen_t *frozen) {
+    xcb_xrm_match_state_t state = {
+        .length = frontier->length,
+        .names = frontier->names,
+        .classes = frontier->classes,
+        .flags = frontier->flags,
+        .frontier = frontier,
+        .frozen = frozen,
+    };
+
+    for (int i = 0; i < frontier->num_items; i++)
+        FREE(frontier->items[i].flags);
+    frontier->num_items = 0;
+
+    frontier->frozen = frozen;
+    if (frozen != NULL) {
+        frontier->generation = frozen->generation;
+        __match_descend_frozen(&state, 0, 0);
+    } else {
+        __match_descend(&state, frontier->database->root, 0);
+    }
+}
+
+/* Picks the best of the collected candidates and frees them. */
+static int __match_pick(xcb_xrm_match_state_t *state, xcb_xrm_resource_t *resource) {
+    xcb_xrm_match_t *best_match = NULL;
+    int result = -FAILURE;
+
+    if (state->num_candidates == 0)
+        goto done;
+
+    /* The flags can only be attached now since the storage might have moved
+     * while collecting the candidates. */
+    for (int i = 0; i < state->num_candidates; i++)
+        state->candidates[i].flags = state->candidate_flags + i * state->length;
+
+    /* The index does not know about the order of the entries, but the
+     * precedence rules depend on it if two entries are equally good, so
+     * compare the candidates in the order they were inserted. */
+    qsort(state->candidates, state->num_candidates, sizeof(xcb_xrm_match_t), __match_compare_positions);
+
+    /* The first matching entry is the first one we pick as the best matching
+     * entry. Then check whether any following match is better than the
+     * current best. */
+    best_match = &(state->candidates[0]);
+    for (int i = 1; i < state->num_candidates; i++) {
+        if (__match_compare(state->length, best_match, &(state->candidates[i])) == 0)
+            best_match = &(state->candidates[i]);
+    }
+
+    resource->entry = best_match->entry;
+    result = SUCCESS;
+
+done:
+    if (state->candidates != state->stack_candidates) {
+        FREE(state->candidates);
+        FREE(state->candidate_flags);
+    }
+    state->num_candidates = 0;
+    state->size_candidates = 0;
+    return result;
+}
 
-    if (cur_comp_db == NULL && cur_comp_name == NULL && (!use_class || cur_comp_class == NULL)) {
-        match->entry = db_entry;
+/* Makes sure the frontier's query buffers can hold length components. */
+static int __match_reserve(xcb_xrm_match_frontier_t *frontier, int length) {
+    xcb_xrm_quark_t *names;
+    xcb_xrm_quark_t *classes;
+    xcb_xrm_match_flags_t *flags;
+
+    if (length <= frontier->size_query)
         return SUCCESS;
+
+    length = MAX(length, 2 * frontier->size_query);
+
+    names = realloc(frontier->names, length * sizeof(xcb_xrm_quark_t));
+    if (names == NULL)
+        return -FAILURE;
+    frontier->names = names;
+
+    if (frontier->with_classes) {
+        classes = realloc(frontier->classes, length * sizeof(xcb_xrm_quark_t));
+        if (classes == NULL)
+            return -FAILURE;
+        frontier->classes = classes;
     }
 
-    return -FAILURE;
+    flags = realloc(frontier->flags, length * sizeof(xcb_xrm_match_flags_t));
+    if (flags == NULL)
+        return -FAILURE;
+    frontier->flags = flags;
+
+    frontier->size_query = length;
+    return SUCCESS;
+}
+
+static int __match_compare_positions(const void *first, const void *second) {
+    const xcb_xrm_match_t *match_first = first;
+    const xcb_xrm_match_t *match_second = second;
+
+    if (match_first->entry->position < match_second->entry->position)
+        return -1;
+
+    return match_first->entry->position > match_second->entry->position;
 }
 
 static int __match_compare(int length, xcb_xrm_match_t *best, xcb_xrm_match_t *candidate) {
@@ -191,22 +673,83 @@ static int __match_compare(int length, xcb_xrm_match_t *best, xcb_xrm_match_t *c
     return -FAILURE;
 }
 
-static xcb_xrm_match_t *__match_new(int length) {
-    xcb_xrm_match_t *match = calloc(1, sizeof(struct xcb_xrm_match_t));
-    if (match == NULL)
+static xcb_xrm_quark_t *__match_quarks(xcb_xrm_entry_t *query, int length) {
+    xcb_xrm_quark_t *quarks = calloc(MAX(length, 1), sizeof(xcb_xrm_quark_t));
+    if (quarks == NULL)
         return NULL;
 
-    match->entry = NULL;
-    match->flags = calloc(1, length * sizeof(xcb_xrm_match_flags_t));
-    if (match->flags == NULL) {
-        FREE(match);
-        return NULL;
-    }
+    for (int i = 0; i < length && i < query->num_components; i++)
+        quarks[i] = query->components[i].quark;
 
-    return match;
+    return quarks;
 }
 
-static void __match_free(xcb_xrm_match_t *match) {
-    FREE(match->flags);
-    FREE(match);
+/* Parses the deferred lines of the database which might match the query.
+ * These all start with a tightly bound component, so they can only match
+ * queries with the same first name or class. */
+static void __match_load(xcb_xrm_database_t *database, const xcb_xrm_quark_t *names,
+        const xcb_xrm_quark_t *classes, int length) {
+    if (database->lazy == NULL || length == 0)
+        return;
+
+    xcb_xrm_database_load(database, names[0]);
+    if (classes != NULL)
+        xcb_xrm_database_load(database, classes[0]);
+}
+
+/* Updates the lookup statistics of the database. If the lookup is timed,
+ * start is the time it started at. */
+static void __match_record(xcb_xrm_database_t *database, const xcb_xrm_quark_t *names,
+        const xcb_xrm_quark_t *classes, int length, int num_candidates, uint64_t start) {
+    uint64_t duration;
+
+    __atomic_add_fetch(&(database->stats.lookups), 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&(database->stats.candidates), num_candidates, __ATOMIC_RELAXED);
+    if (database->trace == NULL)
+        return;
+
+    duration = get_time() - start;
+    __atomic_add_fetch(&(database->stats.match_time), duration, __ATOMIC_RELAXED);
+
+    if (duration >= database->trace_threshold) {
+        char *name = __match_join(names, length);
+        char *class = classes == NULL ? NULL : __match_join(classes, length);
+
+        if (name != NULL && (classes == NULL || class != NULL))
+            database->trace(database->trace_data, name, class, duration);
+
+        FREE(name);
+        FREE(class);
+    }
+}
+
+/* Returns the query for the given quarks as a string, e.g., "Xft.dpi". */
+static char *__match_join(const xcb_xrm_quark_t *quarks, int length) {
+    size_t size = 1;
+    char *result;
+    char *outwalk;
+
+    /* Queries by quark might use quarks which do not exist. */
+    for (int i = 0; i < length; i++) {
+        const char *str = xcb_xrm_quark_string(quarks[i]);
+        size += (str == NULL ? 0 : strlen(str)) + 1;
+    }
+
+    result = malloc(size);
+    if (result == NULL)
+        return NULL;
+
+    outwalk = result;
+    for (int i = 0; i < length; i++) {
+        const char *str = xcb_xrm_quark_string(quarks[i]);
+        size_t len = str == NULL ? 0 : strlen(str);
+
+        if (i > 0)
+            *(outwalk++) = '.';
+        memcpy(outwalk, str, len);
+        outwalk += len;
+    }
+    *outwalk = '\0';
+
+    return result;
 }
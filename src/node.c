@@ -0,0 +1,402 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * Copyright © 2016 Ingo Bürk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the names of the authors or their
+ * institutions shall not be used in advertising or otherwise to promote the
+ * sale, use or other dealings in this Software without prior written
+ * authorization from the authors.
+ *
+ */
+#include "externals.h"
+
+#include "node.h"
+#include "util.h"
+
+/* Forward declarations */
+static size_t __node_home(xcb_xrm_node_table_t *table, xcb_xrm_quark_t quark);
+static xcb_xrm_node_t **__node_slot(xcb_xrm_node_table_t *table, xcb_xrm_quark_t quark);
+static int __node_table_grow(xcb_xrm_node_table_t *table);
+static xcb_xrm_node_t *__node_child(xcb_xrm_node_t *node, xcb_xrm_component_t *component, bool create);
+static void __node_table_free(xcb_xrm_node_table_t *table);
+static bool __node_remove(xcb_xrm_node_t *node, xcb_xrm_entry_t *entry, int index);
+static void __node_table_remove(xcb_xrm_node_table_t *table, xcb_xrm_node_t **slot);
+static bool __node_is_empty(xcb_xrm_node_t *node);
+static int __node_reserve(xcb_xrm_node_t *target, xcb_xrm_node_t *source);
+static int __node_table_reserve(xcb_xrm_node_table_t *target, xcb_xrm_node_table_t *source);
+static void __node_merge(xcb_xrm_node_t *target, xcb_xrm_node_t *source, bool override,
+        xcb_xrm_node_discard_t discard, void *data);
+static void __node_table_merge(xcb_xrm_node_table_t *target, xcb_xrm_node_table_t *source, bool override,
+        xcb_xrm_node_discard_t discard, void *data);
+
+/*
+ * Creates a new, empty node.
+ *
+ */
+xcb_xrm_node_t *xcb_xrm_node_new(void) {
+    return calloc(1, sizeof(struct xcb_xrm_node_t));
+}
+
+/*
+ * Returns the child of the given table for the given quark or NULL if there
+ * is no such child.
+ *
+ */
+xcb_xrm_node_t *xcb_xrm_node_lookup(xcb_xrm_node_table_t *table, xcb_xrm_quark_t quark) {
+    if (!(table->filter & NODE_FILTER_BIT(quark)))
+        return NULL;
+
+    return *__node_slot(table, quark);
+}
+
+/*
+ * Returns the node describing the components of the given entry.
+ * If create is true, missing nodes are created. Otherwise, NULL is returned if
+ * the node does not exist. NULL is also returned if memory could not be
+ * allocated.
+ *
+ */
+xcb_xrm_node_t *xcb_xrm_node_find(xcb_xrm_node_t *root, xcb_xrm_entry_t *entry, bool create) {
+    xcb_xrm_node_t *node = root;
+
+    for (int i = 0; i < entry->num_components; i++) {
+        node = __node_child(node, &(entry->components[i]), create);
+        if (node == NULL)
+            return NULL;
+    }
+
+    return node;
+}
+
+/*
+ * Removes the entry from the node describing its components, if it is that
+ * node's entry. Nodes which are left without an entry and without children
+ * are free'd.
+ *
+ */
+void xcb_xrm_node_remove(xcb_xrm_node_t *root, xcb_xrm_entry_t *entry) {
+    /* The root node is kept even if the database is empty now. */
+    __node_remove(root, entry, 0);
+}
+
+/*
+ * Moves all nodes below source into the tree below target. Where both trees
+ * have a node for the same components, the entry of source replaces the one
+ * of target if override is set and is dropped otherwise. Every entry which
+ * is dropped this way is passed to discard.
+ *
+ */
+int xcb_xrm_node_merge(xcb_xrm_node_t *target, xcb_xrm_node_t *source, bool override,
+        xcb_xrm_node_discard_t discard, void *data) {
+    /* All memory needed is allocated up front so that moving the nodes
+     * cannot fail halfway. Subtrees which only exist in source are moved as
+     * a whole, so only the nodes both trees have are visited. */
+    if (__node_reserve(target, source) < 0)
+        return -FAILURE;
+
+    __node_merge(target, source, override, discard, data);
+    return SUCCESS;
+}
+
+/*
+ * Frees the given node and all of its children. Entries referenced by the
+ * nodes are not freed.
+ *
+ */
+void xcb_xrm_node_free(xcb_xrm_node_t *node) {
+    if (node == NULL)
+        return;
+
+    __node_table_free(&(node->tight));
+    __node_table_free(&(node->loose));
+    xcb_xrm_node_free(node->tight_wildcard);
+    xcb_xrm_node_free(node->loose_wildcard);
+    FREE(node);
+}
+
+/* Returns the slot where the search for the given quark starts. */
+static size_t __node_home(xcb_xrm_node_table_t *table, xcb_xrm_quark_t quark) {
+    /* Quarks are handed out sequentially, so scatter them a bit. */
+    return ((uint32_t) quark * 2654435761u) & (table->size - 1);
+}
+
+/* Returns the slot holding the child for the given quark or the empty slot
+ * where it has to be inserted. The table must have been allocated. */
+static xcb_xrm_node_t **__node_slot(xcb_xrm_node_table_t *table, xcb_xrm_quark_t quark) {
+    size_t mask = table->size - 1;
+    size_t i = __node_home(table, quark);
+
+    while (table->slots[i] != NULL && table->slots[i]->quark != quark)
+        i = (i + 1) & mask;
+
+    return &(table->slots[i]);
+}
+
+static int __node_table_grow(xcb_xrm_node_table_t *table) {
+    xcb_xrm_node_table_t grown = {
+        .size = MAX(4, 2 * table->size),
+        .count = table->count,
+        .filter = table->filter,
+    };
+
+    grown.slots = calloc(grown.size, sizeof(xcb_xrm_node_t *));
+    if (grown.slots == NULL)
+        return -FAILURE;
+
+    for (size_t i = 0; i < table->size; i++) {
+        if (table->slots[i] != NULL)
+            *__node_slot(&grown, table->slots[i]->quark) = table->slots[i];
+    }
+
+    FREE(table->slots);
+    *table = grown;
+    return SUCCESS;
+}
+
+static xcb_xrm_node_t *__node_child(xcb_xrm_node_t *node, xcb_xrm_component_t *component, bool create) {
+    xcb_xrm_node_table_t *table;
+    xcb_xrm_node_t **slot;
+
+    if (component->type == CT_WILDCARD) {
+        slot = (component->binding_type == BT_TIGHT) ? &(node->tight_wildcard) : &(node->loose_wildcard);
+        if (*slot == NULL && create)
+            *slot = xcb_xrm_node_new();
+
+        return *slot;
+    }
+
+    table = (component->binding_type == BT_TIGHT) ? &(node->tight) : &(node->loose);
+    if (!create)
+        return xcb_xrm_node_lookup(table, component->quark);
+
+    /* Keep the load factor of the table below 3/4. */
+    if (4 * (table->count + 1) > 3 * table->size && __node_table_grow(table) < 0)
+        return NULL;
+
+    slot = __node_slot(table, component->quark);
+    if (*slot == NULL) {
+        *slot = xcb_xrm_node_new();
+        if (*slot == NULL)
+            return NULL;
+
+        (*slot)->quark = component->quark;
+        table->count++;
+        table->filter |= NODE_FILTER_BIT(component->quark);
+    }
+
+    return *slot;
+}
+
+static void __node_table_free(xcb_xrm_node_table_t *table) {
+    for (size_t i = 0; i < table->size; i++)
+        xcb_xrm_node_free(table->slots[i]);
+
+    FREE(table->slots);
+    table->size = 0;
+    table->count = 0;
+    table->filter = 0;
+}
+
+/* Removes the entry from the node for its components from the given index on,
+ * freeing the nodes on the way which are left empty. Returns whether node is
+ * empty now. */
+static bool __node_remove(xcb_xrm_node_t *node, xcb_xrm_entry_t *entry, int index) {
+    xcb_xrm_component_t *component;
+    xcb_xrm_node_table_t *table;
+    xcb_xrm_node_t **slot;
+
+    if (index == entry->num_components) {
+        if (node->entry == entry)
+            node->entry = NULL;
+        return __node_is_empty(node);
+    }
+
+    component = &(entry->components[index]);
+    if (component->type == CT_WILDCARD) {
+        slot = (component->binding_type == BT_TIGHT) ? &(node->tight_wildcard) : &(node->loose_wildcard);
+        if (*slot != NULL && __node_remove(*slot, entry, index + 1)) {
+            xcb_xrm_node_free(*slot);
+            *slot = NULL;
+        }
+
+        return __node_is_empty(node);
+    }
+
+    table = (component->binding_type == BT_TIGHT) ? &(node->tight) : &(node->loose);
+    if (xcb_xrm_node_lookup(table, component->quark) == NULL)
+        return false;
+
+    slot = __node_slot(table, component->quark);
+    if (__node_remove(*slot, entry, index + 1)) {
+        xcb_xrm_node_free(*slot);
+        __node_table_remove(table, slot);
+    }
+
+    return __node_is_empty(node);
+}
+
+/* Empties the given slot of the table. The children following it are moved
+ * up so that all of them can still be found from their home slot. */
+static void __node_table_remove(xcb_xrm_node_table_t *table, xcb_xrm_node_t **slot) {
+    size_t mask = table->size - 1;
+    size_t hole = slot - table->slots;
+
+    table->slots[hole] = NULL;
+    table->count--;
+
+    for (size_t i = (hole + 1) & mask; table->slots[i] != NULL; i = (i + 1) & mask) {
+        size_t home = __node_home(table, table->slots[i]->quark);
+
+        /* The child can move into the hole unless its home slot lies
+         * cyclically between the hole and its current slot. */
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            table->slots[hole] = table->slots[i];
+            table->slots[i] = NULL;
+            hole = i;
+        }
+    }
+
+    /* The filter cannot tell which bits other children share, so it is
+     * computed again. */
+    table->filter = 0;
+    for (size_t i = 0; i < table->size; i++) {
+        if (table->slots[i] != NULL)
+            table->filter |= NODE_FILTER_BIT(table->slots[i]->quark);
+    }
+
+    if (table->count == 0) {
+        FREE(table->slots);
+        table->size = 0;
+    }
+}
+
+static bool __node_is_empty(xcb_xrm_node_t *node) {
+    return node->entry == NULL && node->tight.count == 0 && node->loose.count == 0 &&
+        node->tight_wildcard == NULL && node->loose_wildcard == NULL;
+}
+
+/* Grows all tables of target which receive nodes when source is merged into
+ * it. */
+static int __node_reserve(xcb_xrm_node_t *target, xcb_xrm_node_t *source) {
+    xcb_xrm_node_table_t *tables[] = { &(source->tight), &(source->loose) };
+    xcb_xrm_node_table_t *target_tables[] = { &(target->tight), &(target->loose) };
+
+    for (int i = 0; i < 2; i++) {
+        if (__node_table_reserve(target_tables[i], tables[i]) < 0)
+            return -FAILURE;
+
+        for (size_t j = 0; j < tables[i]->size; j++) {
+            xcb_xrm_node_t *child = tables[i]->slots[j];
+            xcb_xrm_node_t *target_child;
+
+            if (child == NULL)
+                continue;
+
+            target_child = xcb_xrm_node_lookup(target_tables[i], child->quark);
+            if (target_child != NULL && __node_reserve(target_child, child) < 0)
+                return -FAILURE;
+        }
+    }
+
+    if (target->tight_wildcard != NULL && source->tight_wildcard != NULL &&
+        __node_reserve(target->tight_wildcard, source->tight_wildcard) < 0)
+        return -FAILURE;
+    if (target->loose_wildcard != NULL && source->loose_wildcard != NULL &&
+        __node_reserve(target->loose_wildcard, source->loose_wildcard) < 0)
+        return -FAILURE;
+
+    return SUCCESS;
+}
+
+/* Grows the target table so that it can take the children of source which it
+ * does not have yet. */
+static int __node_table_reserve(xcb_xrm_node_table_t *target, xcb_xrm_node_table_t *source) {
+    size_t missing = 0;
+
+    for (size_t i = 0; i < source->size; i++) {
+        if (source->slots[i] != NULL && xcb_xrm_node_lookup(target, source->slots[i]->quark) == NULL)
+            missing++;
+    }
+
+    /* Keep the load factor of the table below 3/4. */
+    while (4 * (target->count + missing) > 3 * target->size) {
+        if (__node_table_grow(target) < 0)
+            return -FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+static void __node_merge(xcb_xrm_node_t *target, xcb_xrm_node_t *source, bool override,
+        xcb_xrm_node_discard_t discard, void *data) {
+    xcb_xrm_node_t **wildcards[] = { &(target->tight_wildcard), &(target->loose_wildcard) };
+    xcb_xrm_node_t *source_wildcards[] = { source->tight_wildcard, source->loose_wildcard };
+
+    if (source->entry != NULL) {
+        if (target->entry == NULL) {
+            target->entry = source->entry;
+        } else if (override) {
+            discard(target->entry, data);
+            target->entry = source->entry;
+        } else {
+            discard(source->entry, data);
+        }
+    }
+
+    __node_table_merge(&(target->tight), &(source->tight), override, discard, data);
+    __node_table_merge(&(target->loose), &(source->loose), override, discard, data);
+
+    for (int i = 0; i < 2; i++) {
+        if (source_wildcards[i] == NULL)
+            continue;
+
+        if (*wildcards[i] == NULL)
+            *wildcards[i] = source_wildcards[i];
+        else
+            __node_merge(*wildcards[i], source_wildcards[i], override, discard, data);
+    }
+
+    FREE(source);
+}
+
+static void __node_table_merge(xcb_xrm_node_table_t *target, xcb_xrm_node_table_t *source, bool override,
+        xcb_xrm_node_discard_t discard, void *data) {
+    for (size_t i = 0; i < source->size; i++) {
+        xcb_xrm_node_t **slot;
+
+        if (source->slots[i] == NULL)
+            continue;
+
+        slot = __node_slot(target, source->slots[i]->quark);
+        if (*slot == NULL) {
+            *slot = source->slots[i];
+            target->count++;
+            target->filter |= NODE_FILTER_BIT(source->slots[i]->quark);
+        } else {
+            __node_merge(*slot, source->slots[i], override, discard, data);
+        }
+    }
+
+    FREE(source->slots);
+    source->size = 0;
+    source->count = 0;
+    source->filter = 0;
+}
@@ -0,0 +1,275 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * Copyright © 2016 Ingo Bürk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the names of the authors or their
+ * institutions shall not be used in advertising or otherwise to promote the
+ * sale, use or other dealings in this Software without prior written
+ * authorization from the authors.
+ *
+ */
+#include "externals.h"
+
+#include <pthread.h>
+
+#include "quark.h"
+#include "entry.h"
+#include "util.h"
+
+/* A slot of the hash table. Slots are published by atomically storing str,
+ * so readers which see it also see the quark. */
+typedef struct quark_slot_t {
+    const char *str;
+    xcb_xrm_quark_t quark;
+} quark_slot_t;
+
+/* Open addressing hash table of quarks. Tables are never modified other than
+ * by filling empty slots; when a table has to grow, a new one replaces it. */
+typedef struct quark_table_t {
+    size_t size;
+    quark_slot_t *slots;
+    /* The table which has been replaced by this table. Replaced tables are
+     * kept since readers might still be using them. */
+    struct quark_table_t *previous;
+} quark_table_t;
+
+/* All interned strings are kept in a process-wide table. Adding strings is
+ * protected by this mutex, but looking up existing quarks is lock-free. */
+static pthread_mutex_t quark_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Maps a quark to its string. Index 0 is reserved for XCB_XRM_NULLQUARK.
+ * This is protected by quark_mutex. */
+static char **quark_strings = NULL;
+static size_t quark_strings_size = 0;
+static size_t quark_count = 1;
+
+static quark_table_t *quark_table = NULL;
+
+/* Forward declarations */
+static xcb_xrm_quark_t __quark_lookup(quark_table_t *table, const char *str, size_t len, const char **interned);
+static quark_slot_t *__quark_slot(quark_table_t *table, const char *str, size_t len);
+static int __quark_grow(void);
+
+/*
+ * Returns the quark for the first len bytes of str, allocating a new quark if
+ * the string has not been seen before.
+ * Quarks are process-wide and are never freed. If interned is not NULL, it is
+ * set to the string owned by the quark table.
+ *
+ * @return The quark or XCB_XRM_NULLQUARK if memory could not be allocated.
+ *
+ */
+xcb_xrm_quark_t xcb_xrm_quark_intern(const char *str, size_t len, const char **interned) {
+    quark_slot_t *slot;
+    xcb_xrm_quark_t quark;
+    char *copy;
+
+    /* Most strings have been interned already, which we can find out without
+     * taking the lock. */
+    quark = __quark_lookup(__atomic_load_n(&quark_table, __ATOMIC_ACQUIRE), str, len, interned);
+    if (quark != XCB_XRM_NULLQUARK)
+        return quark;
+
+    pthread_mutex_lock(&quark_mutex);
+
+    /* Keep the load factor of the hash table below 1/2. */
+    if ((quark_table == NULL || 2 * quark_count >= quark_table->size) && __quark_grow() < 0)
+        goto done;
+
+    slot = __quark_slot(quark_table, str, len);
+    if (slot->str != NULL) {
+        quark = slot->quark;
+        if (interned != NULL)
+            *interned = slot->str;
+        goto done;
+    }
+
+    if (quark_count >= quark_strings_size) {
+        size_t new_size = MAX(64, 2 * quark_strings_size);
+        char **new_strings = realloc(quark_strings, new_size * sizeof(char *));
+        if (new_strings == NULL)
+            goto done;
+
+        quark_strings = new_strings;
+        quark_strings_size = new_size;
+    }
+
+    copy = strndup(str, len);
+    if (copy == NULL)
+        goto done;
+
+    quark = quark_count++;
+    quark_strings[quark] = copy;
+    slot->quark = quark;
+    __atomic_store_n(&(slot->str), copy, __ATOMIC_RELEASE);
+    if (interned != NULL)
+        *interned = copy;
+
+done:
+    pthread_mutex_unlock(&quark_mutex);
+    return quark;
+}
+
+/*
+ * Returns the string represented by the given quark or NULL if the quark is
+ * unknown. The string is owned by the quark table and must not be modified.
+ *
+ */
+const char *xcb_xrm_quark_string(xcb_xrm_quark_t quark) {
+    const char *result = NULL;
+
+    pthread_mutex_lock(&quark_mutex);
+    if (quark > XCB_XRM_NULLQUARK && (size_t) quark < quark_count)
+        result = quark_strings[quark];
+    pthread_mutex_unlock(&quark_mutex);
+
+    return result;
+}
+
+/*
+ * Returns the quark for the given string, creating it if necessary.
+ *
+ * @param str The string to convert, e.g., "urxvt".
+ * @returns The quark representing the string or XCB_XRM_NULLQUARK if str is
+ * NULL or memory could not be allocated.
+ */
+xcb_xrm_quark_t xcb_xrm_string_to_quark(const char *str) {
+    if (str == NULL)
+        return XCB_XRM_NULLQUARK;
+
+    return xcb_xrm_quark_intern(str, strlen(str), NULL);
+}
+
+/*
+ * Converts a fully qualified resource name or class into a list of quarks,
+ * one for each component. The list is terminated by XCB_XRM_NULLQUARK.
+ *
+ * @param str The resource name or class, e.g., "urxvt.font".
+ * @param quarks The array to store the quarks in.
+ * @param size The number of elements quarks can hold, including the
+ * terminating XCB_XRM_NULLQUARK.
+ * @returns The number of components or a negative value if str is not a
+ * valid resource name or quarks is too small.
+ */
+int xcb_xrm_string_to_quark_list(const char *str, xcb_xrm_quark_t *quarks, size_t size) {
+    xcb_xrm_entry_t *entry;
+    size_t num = 0;
+
+    if (str == NULL || xcb_xrm_entry_parse(str, &entry, true) < 0)
+        return -FAILURE;
+
+    for (int i = 0; i < entry->num_components; i++) {
+        if (num + 1 >= size) {
+            xcb_xrm_entry_free(entry);
+            return -FAILURE;
+        }
+
+        quarks[num++] = entry->components[i].quark;
+    }
+
+    quarks[num] = XCB_XRM_NULLQUARK;
+    xcb_xrm_entry_free(entry);
+    return num;
+}
+
+/*
+ * Returns the string represented by a quark.
+ * The string is owned by the library and must not be modified or free'd.
+ *
+ * @param quark The quark to convert.
+ * @returns The string represented by the quark or NULL if the quark is
+ * unknown.
+ */
+const char *xcb_xrm_quark_to_string(xcb_xrm_quark_t quark) {
+    return xcb_xrm_quark_string(quark);
+}
+
+/* Returns the quark for the given string or XCB_XRM_NULLQUARK if it has not
+ * been interned. If it has and interned is not NULL, it is set to the string
+ * of the quark. This does not need to hold quark_mutex. */
+static xcb_xrm_quark_t __quark_lookup(quark_table_t *table, const char *str, size_t len, const char **interned) {
+    size_t mask;
+    size_t i;
+
+    if (table == NULL)
+        return XCB_XRM_NULLQUARK;
+
+    mask = table->size - 1;
+    i = hash_bytes(str, len) & mask;
+
+    for (;;) {
+        const char *candidate = __atomic_load_n(&(table->slots[i].str), __ATOMIC_ACQUIRE);
+        if (candidate == NULL)
+            return XCB_XRM_NULLQUARK;
+
+        if (strncmp(candidate, str, len) == 0 && candidate[len] == '\0') {
+            if (interned != NULL)
+                *interned = candidate;
+            return table->slots[i].quark;
+        }
+
+        i = (i + 1) & mask;
+    }
+}
+
+/* Returns the slot holding the given string or the empty slot where it has to
+ * be inserted. The caller must hold quark_mutex. */
+static quark_slot_t *__quark_slot(quark_table_t *table, const char *str, size_t len) {
+    size_t mask = table->size - 1;
+    size_t i = hash_bytes(str, len) & mask;
+
+    while (table->slots[i].str != NULL) {
+        const char *candidate = table->slots[i].str;
+        if (strncmp(candidate, str, len) == 0 && candidate[len] == '\0')
+            break;
+
+        i = (i + 1) & mask;
+    }
+
+    return &(table->slots[i]);
+}
+
+/* Replaces the hash table by one of twice the size. The caller must hold
+ * quark_mutex. */
+static int __quark_grow(void) {
+    quark_table_t *table = calloc(1, sizeof(quark_table_t));
+    if (table == NULL)
+        return -FAILURE;
+
+    table->size = quark_table == NULL ? 128 : 2 * quark_table->size;
+    table->slots = calloc(table->size, sizeof(quark_slot_t));
+    if (table->slots == NULL) {
+        FREE(table);
+        return -FAILURE;
+    }
+
+    for (size_t quark = 1; quark < quark_count; quark++) {
+        const char *str = quark_strings[quark];
+        quark_slot_t *slot = __quark_slot(table, str, strlen(str));
+
+        slot->str = str;
+        slot->quark = quark;
+    }
+
+    table->previous = quark_table;
+    __atomic_store_n(&quark_table, table, __ATOMIC_RELEASE);
+    return SUCCESS;
+}
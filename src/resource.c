@@ -31,12 +31,20 @@
 #include "resource.h"
 #include "database.h"
 #include "match.h"
+#include "search_list.h"
 #include "util.h"
 
+/* Queries with up to this many components are resolved without allocating
+ * memory for the query. */
+#define QUERY_STACK_COMPONENTS 16
+
 /* Forward declarations */
-static int __resource_get(xcb_xrm_database_t *database, const char *res_name, const char *res_class,
-                         xcb_xrm_resource_t **_resource);
-static void __resource_free(xcb_xrm_resource_t *resource);
+static xcb_xrm_entry_t *__resource_get(xcb_xrm_database_t *database, const char *res_name, const char *res_class);
+static xcb_xrm_entry_t *__resource_get_q(xcb_xrm_database_t *database, const xcb_xrm_quark_t *res_names,
+        const xcb_xrm_quark_t *res_classes);
+static int __resource_parse_quarks(const char *str, xcb_xrm_quark_t *stack, xcb_xrm_quark_t **quarks);
+static long __resource_to_long(xcb_xrm_entry_t *entry);
+static bool __resource_to_bool(xcb_xrm_entry_t *entry);
 
 /*
  * Returns the string value of a resource.
@@ -53,19 +61,252 @@ static void __resource_free(xcb_xrm_resource_t *resource);
  */
 char *xcb_xrm_resource_get_string(xcb_xrm_database_t *database,
         const char *res_name, const char *res_class) {
-    char *value = NULL;
+    const char *value = xcb_xrm_resource_get_string_borrowed(database, res_name, res_class);
+    if (value == NULL)
+        return NULL;
+
+    return strdup(value);
+}
+
+/*
+ * Returns the string value of a resource without copying it.
+ * If the resource cannot be found, NULL is returned.
+ *
+ * The string is owned by the database and must neither be modified nor
+ * free'd. It is only valid until the database is modified or destroyed.
+ *
+ * @param database The database to query.
+ * @param res_name The fully qualified resource name string.
+ * @param res_class The fully qualified resource class string. This argument
+ * may be left empty / NULL, but if given, it must contain the same number of
+ * components as res_name.
+ * @returns The string value of the resource or NULL otherwise.
+ */
+const char *xcb_xrm_resource_get_string_borrowed(xcb_xrm_database_t *database,
+        const char *res_name, const char *res_class) {
+    xcb_xrm_entry_t *entry = __resource_get(database, res_name, res_class);
+    if (entry == NULL)
+        return NULL;
 
-    xcb_xrm_resource_t *resource;
-    if (__resource_get(database, res_name, res_class, &resource) < 0) {
-        __resource_free(resource);
+    assert(entry->value != NULL);
+    return entry->value;
+}
+
+/*
+ * Returns the string value of a resource given the quarks of the name and
+ * class components. This is equivalent to @ref xcb_xrm_resource_get_string,
+ * but avoids parsing the query strings.
+ * If the resource cannot be found, NULL is returned.
+ *
+ * Note that the string is owned by the caller and must be free'd.
+ *
+ * @param database The database to query.
+ * @param res_names The quarks of the fully qualified resource name,
+ * terminated by XCB_XRM_NULLQUARK.
+ * @param res_classes The quarks of the fully qualified resource class,
+ * terminated by XCB_XRM_NULLQUARK. This argument may be NULL, but if given,
+ * it must contain the same number of components as res_names.
+ * @returns The string value of the resource or NULL otherwise.
+ */
+char *xcb_xrm_resource_get_string_q(xcb_xrm_database_t *database,
+        const xcb_xrm_quark_t *res_names, const xcb_xrm_quark_t *res_classes) {
+    xcb_xrm_entry_t *entry = __resource_get_q(database, res_names, res_classes);
+    if (entry == NULL)
         return NULL;
+
+    return strdup(entry->value);
+}
+
+/*
+ * Looks up the string values of several resources sharing a common prefix.
+ * The prefix is matched against the database only once, which makes this
+ * considerably faster than looking up each resource on its own.
+ *
+ * The i-th resource is looked up with the name prefix_name.leaf_names[i] and
+ * the class prefix_class.leaf_classes[i]. If it cannot be found, the i-th
+ * element of out_values is set to NULL.
+ *
+ * The strings are owned by the database and must neither be modified nor
+ * free'd. They are only valid until the database is modified or destroyed.
+ *
+ * @param database The database to query.
+ * @param prefix_name The name components shared by all resources, e.g.,
+ * "myapp.button". This argument may be left empty / NULL to look up the leaves
+ * on their own.
+ * @param prefix_class The class components shared by all resources. This
+ * argument may be left empty / NULL, but if given, it must contain the same
+ * number of components as prefix_name.
+ * @param leaf_names The remaining name components of each resource, e.g.,
+ * "font". Each of them may consist of multiple components.
+ * @param leaf_classes The remaining class components of each resource or NULL
+ * to look up all resources without a class. Elements may be left empty /
+ * NULL, but if given, they must contain the same number of components as the
+ * corresponding leaf name.
+ * @param n The number of resources to look up.
+ * @param out_values An array of n elements which the values are stored in.
+ * @returns The number of resources which have been found or a negative
+ * number on error.
+ */
+int xcb_xrm_resource_get_batch(xcb_xrm_database_t *database,
+        const char *prefix_name, const char *prefix_class,
+        const char **leaf_names, const char **leaf_classes, size_t n, const char **out_values) {
+    xcb_xrm_search_list_t *list;
+    int found = 0;
+
+    if (n > 0 && (leaf_names == NULL || out_values == NULL))
+        return -FAILURE;
+
+    for (size_t i = 0; i < n; i++)
+        out_values[i] = NULL;
+
+    if (database == NULL || n == 0)
+        return 0;
+
+    list = xcb_xrm_database_get_search_list(database, prefix_name, prefix_class);
+    if (list == NULL)
+        return -FAILURE;
+
+    for (size_t i = 0; i < n; i++) {
+        out_values[i] = xcb_xrm_search_list_get_resource(list, leaf_names[i],
+                leaf_classes == NULL ? NULL : leaf_classes[i]);
+        if (out_values[i] != NULL)
+            found++;
     }
 
-    assert(resource->value != NULL);
-    value = strdup(resource->value);
-    __resource_free(resource);
+    xcb_xrm_search_list_free(list);
+    return found;
+}
+
+/*
+ * Matches the given resource name / class prefix against the database for
+ * looking up resources sharing this prefix with @ref
+ * xcb_xrm_search_list_get_resource (). This is the equivalent of
+ * XrmQGetSearchList().
+ *
+ * The search list is only valid until the database is modified or destroyed.
+ * Search lists of a database shared between threads (see @ref
+ * xcb_xrm_database_enable_concurrency) stay valid when it is modified and
+ * look up resources without blocking, like all other lookups.
+ *
+ * @param database The database to query.
+ * @param names The name components shared by all resources, e.g.,
+ * "myapp.button". This argument may be left empty / NULL to look up resources
+ * on their own.
+ * @param classes The class components shared by all resources. This argument
+ * may be left empty / NULL, but if given, it must contain the same number of
+ * components as names.
+ * @returns The search list or NULL on error.
+ */
+xcb_xrm_search_list_t *xcb_xrm_database_get_search_list(xcb_xrm_database_t *database,
+        const char *names, const char *classes) {
+    xcb_xrm_quark_t stack_names[QUERY_STACK_COMPONENTS + 1];
+    xcb_xrm_quark_t stack_classes[QUERY_STACK_COMPONENTS + 1];
+    xcb_xrm_quark_t *name_quarks = stack_names;
+    xcb_xrm_quark_t *class_quarks = NULL;
+    xcb_xrm_search_list_t *list = NULL;
+    int num_names = 0;
 
-    return value;
+    if (database == NULL)
+        return NULL;
+
+    if (names != NULL && names[0] == '\0')
+        names = NULL;
+    if (classes != NULL && classes[0] == '\0')
+        classes = NULL;
+
+    if (names != NULL && (num_names = __resource_parse_quarks(names, stack_names, &name_quarks)) < 0)
+        goto done;
+
+    if (classes != NULL && __resource_parse_quarks(classes, stack_classes, &class_quarks) != num_names)
+        goto done;
+
+    list = calloc(1, sizeof(struct xcb_xrm_search_list_t));
+    if (list == NULL)
+        goto done;
+
+    if (xcb_xrm_match_frontier_init(database, &(list->frontier), name_quarks, class_quarks, num_names) < 0)
+        FREE(list);
+
+done:
+    if (name_quarks != stack_names)
+        FREE(name_quarks);
+    if (class_quarks != stack_classes)
+        FREE(class_quarks);
+    return list;
+}
+
+/*
+ * Returns the string value of the resource consisting of the search list's
+ * prefix followed by the given components. This is the equivalent of
+ * XrmQGetSearchResource() and yields the same result as @ref
+ * xcb_xrm_resource_get_string () for the full resource name and class.
+ * If the resource cannot be found, NULL is returned.
+ *
+ * The string is owned by the database and must neither be modified nor
+ * free'd. It is only valid until the database is modified or destroyed.
+ *
+ * A search list must not be used by several threads at the same time.
+ *
+ * @param list The search list to use.
+ * @param leaf_name The remaining resource name components, e.g., "font".
+ * @param leaf_class The remaining resource class components. This argument
+ * may be left empty / NULL, but if given, it must contain the same number of
+ * components as leaf_name and the search list must have been created with a
+ * class.
+ * @returns The string value of the resource or NULL otherwise.
+ */
+const char *xcb_xrm_search_list_get_resource(xcb_xrm_search_list_t *list,
+        const char *leaf_name, const char *leaf_class) {
+    xcb_xrm_quark_t stack_names[QUERY_STACK_COMPONENTS + 1];
+    xcb_xrm_quark_t stack_classes[QUERY_STACK_COMPONENTS + 1];
+    xcb_xrm_quark_t *names = stack_names;
+    xcb_xrm_quark_t *classes = NULL;
+    xcb_xrm_resource_t resource = { .entry = NULL };
+    int num_names;
+
+    if (list == NULL || leaf_name == NULL)
+        return NULL;
+
+    if (leaf_class != NULL && leaf_class[0] == '\0')
+        leaf_class = NULL;
+
+    num_names = __resource_parse_quarks(leaf_name, stack_names, &names);
+    if (num_names < 0)
+        goto done;
+
+    if (leaf_class != NULL && __resource_parse_quarks(leaf_class, stack_classes, &classes) != num_names)
+        goto done;
+
+    /* The entries of a concurrent database may be modified at any time, so
+     * they must not be used by lookups. */
+    if (list->frontier.database->concurrent || list->frontier.database->lazy != NULL ||
+            !TAILQ_EMPTY(&(list->frontier.database->entries)))
+        xcb_xrm_match_frontier_resolve(&(list->frontier), names, classes, num_names, &resource);
+
+done:
+    if (names != stack_names)
+        FREE(names);
+    if (classes != stack_classes)
+        FREE(classes);
+
+    if (resource.entry == NULL)
+        return NULL;
+
+    assert(resource.entry->value != NULL);
+    return resource.entry->value;
+}
+
+/*
+ * Destroys the given search list.
+ *
+ * @param list The search list to destroy.
+ */
+void xcb_xrm_search_list_free(xcb_xrm_search_list_t *list) {
+    if (list == NULL)
+        return;
+
+    xcb_xrm_match_frontier_free(&(list->frontier));
+    FREE(list);
 }
 
 /*
@@ -82,13 +323,11 @@ char *xcb_xrm_resource_get_string(xcb_xrm_database_t *database,
  */
 long xcb_xrm_resource_get_long(xcb_xrm_database_t *database,
         const char *res_name, const char *res_class) {
-    long value;
-    char *str = xcb_xrm_resource_get_string(database, res_name, res_class);
+    xcb_xrm_entry_t *entry = __resource_get(database, res_name, res_class);
+    if (entry == NULL)
+        return LONG_MIN;
 
-    value = xcb_xrm_convert_to_long(str);
-    FREE(str);
-
-    return value;
+    return __resource_to_long(entry);
 }
 
 /*
@@ -114,68 +353,151 @@ long xcb_xrm_resource_get_long(xcb_xrm_database_t *database,
  */
 bool xcb_xrm_resource_get_bool(xcb_xrm_database_t *database,
         const char *res_name, const char *res_class) {
-    bool value;
-    char *str = xcb_xrm_resource_get_string(database, res_name, res_class);
-
-    value = xcb_xrm_convert_to_bool(str);
-    FREE(str);
+    xcb_xrm_entry_t *entry = __resource_get(database, res_name, res_class);
+    if (entry == NULL)
+        return false;
 
-    return value;
+    return __resource_to_bool(entry);
 }
 
-static int __resource_get(xcb_xrm_database_t *database, const char *res_name, const char *res_class,
-                         xcb_xrm_resource_t **_resource) {
-    xcb_xrm_resource_t *resource;
-    xcb_xrm_entry_t *query_name = NULL;
-    xcb_xrm_entry_t *query_class = NULL;
-    int result = SUCCESS;
+static xcb_xrm_entry_t *__resource_get(xcb_xrm_database_t *database, const char *res_name, const char *res_class) {
+    xcb_xrm_quark_t stack_names[QUERY_STACK_COMPONENTS + 1];
+    xcb_xrm_quark_t stack_classes[QUERY_STACK_COMPONENTS + 1];
+    xcb_xrm_quark_t *names = stack_names;
+    xcb_xrm_quark_t *classes = NULL;
+    xcb_xrm_entry_t *entry = NULL;
+    int num_names;
+    int num_classes;
 
-    if (database == NULL || TAILQ_EMPTY(database)) {
-        *_resource = NULL;
-        return -FAILURE;
-    }
-
-    *_resource = calloc(1, sizeof(struct xcb_xrm_resource_t));
-    if (_resource == NULL) {
-        result = -FAILURE;
-        goto done;
-    }
-    resource = *_resource;
+    if (database == NULL || res_name == NULL)
+        return NULL;
 
-    if (res_name == NULL || xcb_xrm_entry_parse(res_name, &query_name, true) < 0) {
-        result = -FAILURE;
-        goto done;
-    }
+    /* The entries of a concurrent database may be modified at any time, so
+     * they must not be used by lookups. */
+    if (!database->concurrent && database->lazy == NULL && TAILQ_EMPTY(&(database->entries)))
+        return NULL;
 
     /* For the resource class input, we allow NULL and empty string as
      * placeholders for not specifying this string. Technically this is
      * violating the spec, but it seems to be widely used. */
-    if (res_class != NULL && strlen(res_class) > 0 &&
-            xcb_xrm_entry_parse(res_class, &query_class, true) < 0) {
-        result = -1;
-        goto done;
+    if (res_class != NULL && res_class[0] == '\0')
+        res_class = NULL;
+
+    /* Repeated queries are answered from the cache, if it is enabled. The
+     * cache is not used for concurrent databases. */
+    if (!database->concurrent && xcb_xrm_cache_lookup(&(database->cache), database->generation, res_name,
+                res_class == NULL ? "" : res_class, &entry)) {
+        return entry;
     }
 
-    /* We rely on name and class query strings to have the same number of
-     * components, so let's check that this is the case. The specification
-     * backs us up here. */
-    if (query_class != NULL &&
-            xcb_xrm_entry_num_components(query_name) != xcb_xrm_entry_num_components(query_class)) {
-        result = -1;
+    num_names = __resource_parse_quarks(res_name, stack_names, &names);
+    if (num_names < 0)
         goto done;
+
+    if (res_class != NULL) {
+        /* We rely on name and class query strings to have the same number of
+         * components, so let's check that this is the case. The specification
+         * backs us up here. */
+        num_classes = __resource_parse_quarks(res_class, stack_classes, &classes);
+        if (num_classes != num_names)
+            goto done;
     }
 
-    result = xcb_xrm_match(database, query_name, query_class, resource);
+    entry = __resource_get_q(database, names, classes);
+    if (!database->concurrent)
+        xcb_xrm_cache_store(&(database->cache), database->generation, res_name,
+                res_class == NULL ? "" : res_class, entry);
+
 done:
-    xcb_xrm_entry_free(query_name);
-    xcb_xrm_entry_free(query_class);
-    return result;
+    if (names != stack_names)
+        FREE(names);
+    if (classes != stack_classes)
+        FREE(classes);
+    return entry;
 }
 
-static void __resource_free(xcb_xrm_resource_t *resource) {
-    if (resource == NULL)
-        return;
+static xcb_xrm_entry_t *__resource_get_q(xcb_xrm_database_t *database, const xcb_xrm_quark_t *res_names,
+        const xcb_xrm_quark_t *res_classes) {
+    xcb_xrm_resource_t resource = { .entry = NULL };
+    int num_names = 0;
+
+    if (database == NULL || res_names == NULL)
+        return NULL;
+
+    if (!database->concurrent && database->lazy == NULL && TAILQ_EMPTY(&(database->entries)))
+        return NULL;
+
+    while (res_names[num_names] != XCB_XRM_NULLQUARK)
+        num_names++;
+    if (num_names == 0)
+        return NULL;
+
+    /* Just like for string queries, an empty class list is treated like no
+     * class list at all. */
+    if (res_classes != NULL && res_classes[0] == XCB_XRM_NULLQUARK)
+        res_classes = NULL;
+
+    if (res_classes != NULL) {
+        int num_classes = 0;
+        while (res_classes[num_classes] != XCB_XRM_NULLQUARK)
+            num_classes++;
+
+        if (num_classes != num_names)
+            return NULL;
+    }
+
+    if (xcb_xrm_match_quarks(database, res_names, res_classes, num_names, &resource) < 0)
+        return NULL;
 
-    FREE(resource->value);
-    FREE(resource);
+    return resource.entry;
+}
+
+/* Parses the components of str into quarks terminated by XCB_XRM_NULLQUARK.
+ * The stack buffer of QUERY_STACK_COMPONENTS + 1 elements is used if it is
+ * large enough; otherwise, *quarks is allocated and must be free'd.
+ * Returns the number of components or a negative number on error. */
+static int __resource_parse_quarks(const char *str, xcb_xrm_quark_t *stack, xcb_xrm_quark_t **quarks) {
+    int num = xcb_xrm_entry_parse_quarks(str, stack, QUERY_STACK_COMPONENTS);
+
+    *quarks = stack;
+    if (num > QUERY_STACK_COMPONENTS) {
+        xcb_xrm_quark_t *heap = calloc(num + 1, sizeof(xcb_xrm_quark_t));
+        if (heap == NULL)
+            return -FAILURE;
+
+        xcb_xrm_entry_parse_quarks(str, heap, num);
+        *quarks = heap;
+    }
+
+    if (num >= 0)
+        (*quarks)[num] = XCB_XRM_NULLQUARK;
+    return num;
+}
+
+/* Returns the value of the entry converted to a long and caches it. Lookups
+ * in a concurrent database may convert the same entry at the same time, but
+ * they all store the same result. */
+static long __resource_to_long(xcb_xrm_entry_t *entry) {
+    long value;
+
+    if (__atomic_load_n(&(entry->converted), __ATOMIC_ACQUIRE) & EC_LONG)
+        return __atomic_load_n(&(entry->long_value), __ATOMIC_RELAXED);
+
+    value = xcb_xrm_convert_to_long(entry->value);
+    __atomic_store_n(&(entry->long_value), value, __ATOMIC_RELAXED);
+    __atomic_or_fetch(&(entry->converted), EC_LONG, __ATOMIC_RELEASE);
+    return value;
+}
+
+/* The same as __resource_to_long, but for bools. */
+static bool __resource_to_bool(xcb_xrm_entry_t *entry) {
+    bool value;
+
+    if (__atomic_load_n(&(entry->converted), __ATOMIC_ACQUIRE) & EC_BOOL)
+        return __atomic_load_n(&(entry->bool_value), __ATOMIC_RELAXED);
+
+    value = xcb_xrm_convert_to_bool(entry->value);
+    __atomic_store_n(&(entry->bool_value), value, __ATOMIC_RELAXED);
+    __atomic_or_fetch(&(entry->converted), EC_BOOL, __ATOMIC_RELEASE);
+    return value;
 }
@@ -30,6 +30,10 @@
 
 #include "util.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 int str2long(long *out, const char *input, const int base) {
     char *end;
     long result;
@@ -50,6 +54,61 @@ int str2long(long *out, const char *input, const int base) {
     return SUCCESS;
 }
 
+/* FNV-1a, which is simple and good enough for the short strings we hash. */
+uint32_t hash_bytes(const char *data, size_t len) {
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char) data[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/* The 64-bit variant of hash_bytes for when collisions must be unlikely. */
+uint64_t hash_bytes_64(const char *data, size_t len) {
+    uint64_t hash = 14695981039346656037u;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char) data[i];
+        hash *= 1099511628211u;
+    }
+
+    return hash;
+}
+
+/* Returns the first character in [str, end) which is one of the given
+ * characters or end if there is none. */
+const char *find_chars(const char *str, const char *end, char first, char second, char third) {
+#ifdef __SSE2__
+    /* SSE2 is part of every x86-64 CPU, so there is nothing to detect at
+     * runtime. Look at 16 bytes at a time and at single bytes for the rest. */
+    const __m128i first_v = _mm_set1_epi8(first);
+    const __m128i second_v = _mm_set1_epi8(second);
+    const __m128i third_v = _mm_set1_epi8(third);
+
+    while (end - str >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) str);
+        __m128i hits = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, first_v), _mm_cmpeq_epi8(chunk, second_v)),
+                _mm_cmpeq_epi8(chunk, third_v));
+        int mask = _mm_movemask_epi8(hits);
+
+        if (mask != 0)
+            return str + __builtin_ctz(mask);
+        str += 16;
+    }
+#endif
+
+    for (; str < end; str++) {
+        if (*str == first || *str == second || *str == third)
+            return str;
+    }
+
+    return end;
+}
+
 char *get_home_dir_file(const char *filename) {
     char *result;
 
@@ -63,70 +122,154 @@ char *get_home_dir_file(const char *filename) {
     return result;
 }
 
-char *file_get_contents(const char *filename) {
-    FILE *file;
+/* Returns the time of a monotonic clock in nanoseconds. */
+uint64_t get_time(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+int file_map_contents(const char *filename, file_contents_t *contents) {
     struct stat stbuf;
-    size_t file_size;
-    char *content;
+    size_t size = 0;
+    int fd;
 
-    if ((file = fopen(filename, "rb")) == NULL)
-        return NULL;
+    memset(contents, 0, sizeof(file_contents_t));
 
-    /* We want to read the file in one go, so figure out the file size. */
-    if (fstat(fileno(file), &stbuf) < 0) {
-        fclose(file);
-        return NULL;
+    if ((fd = open(filename, O_RDONLY | O_CLOEXEC)) < 0)
+        return -FAILURE;
+
+    if (fstat(fd, &stbuf) < 0) {
+        close(fd);
+        return -FAILURE;
     }
-    file_size = stbuf.st_size;
 
-    /* Read the file content. */
-    content = calloc(file_size + 1, 1);
-    if (content == NULL) {
-        fclose(file);
-        return NULL;
+    /* Regular files are mapped, so their contents are read right from the
+     * page cache. */
+    if (S_ISREG(stbuf.st_mode) && stbuf.st_size > 0) {
+        void *data = mmap(NULL, stbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, stbuf.st_size, MADV_SEQUENTIAL);
+            close(fd);
+
+            contents->data = data;
+            contents->length = stbuf.st_size;
+            contents->mapped = true;
+            return SUCCESS;
+        }
     }
 
-    if (fread(content, 1, file_size, file) != file_size) {
-        FREE(content);
-        fclose(file);
-        return NULL;
+    /* Otherwise, e.g., for pipes or files whose size is not known up front,
+     * read until the end of the file. */
+    for (;;) {
+        ssize_t num_read;
+
+        if (contents->length == size) {
+            size_t new_size = MAX(4096, 2 * size);
+            char *new_data = realloc(contents->data, new_size);
+            if (new_data == NULL)
+                goto fail;
+
+            contents->data = new_data;
+            size = new_size;
+        }
+
+        num_read = read(fd, contents->data + contents->length, size - contents->length);
+        if (num_read < 0 && errno == EINTR)
+            continue;
+        if (num_read < 0)
+            goto fail;
+        if (num_read == 0)
+            break;
+
+        contents->length += num_read;
     }
 
-    fclose(file);
-    content[file_size] = '\0';
-    return content;
+    close(fd);
+    return SUCCESS;
+
+fail:
+    close(fd);
+    FREE(contents->data);
+    contents->length = 0;
+    return -FAILURE;
 }
 
-char *xcb_util_get_property(xcb_connection_t *conn, xcb_window_t window, xcb_atom_t atom,
-        xcb_atom_t type, size_t size) {
-    xcb_get_property_cookie_t cookie;
+void file_unmap_contents(file_contents_t *contents) {
+    if (contents->mapped)
+        munmap(contents->data, contents->length);
+    else
+        free(contents->data);
+
+    contents->data = NULL;
+    contents->length = 0;
+    contents->mapped = false;
+}
+
+xcb_get_property_cookie_t xcb_util_get_property_request(xcb_connection_t *conn, xcb_window_t window,
+        xcb_atom_t atom, xcb_atom_t type, size_t size) {
+    return xcb_get_property(conn, 0, window, atom, type, 0, size);
+}
+
+char *xcb_util_get_property_reply(xcb_connection_t *conn, xcb_get_property_cookie_t cookie,
+        xcb_window_t window, xcb_atom_t atom, xcb_atom_t type) {
     xcb_get_property_reply_t *reply;
     xcb_generic_error_t *err;
-    int reply_length;
-    char *content;
+    size_t content_length = 0;
+    size_t content_size = 0;
+    char *content = NULL;
 
-    cookie = xcb_get_property(conn, 0, window, atom, type, 0, size);
-    reply = xcb_get_property_reply(conn, cookie, &err);
-    if (err != NULL) {
-        FREE(err);
-        return NULL;
-    }
+    for (;;) {
+        size_t reply_length;
 
-    if (reply == NULL || (reply_length = xcb_get_property_value_length(reply)) == 0) {
-        return NULL;
-    }
+        reply = xcb_get_property_reply(conn, cookie, &err);
+        if (err != NULL || reply == NULL || (reply_length = xcb_get_property_value_length(reply)) == 0)
+            goto fail;
 
-    if (reply->bytes_after > 0) {
-        size_t adjusted_size = size + ceil(reply->bytes_after / 4.0);
-        FREE(reply);
-        return xcb_util_get_property(conn, window, atom, type, adjusted_size);
-    }
+        /* Make room for this reply and for everything which is still left, so
+         * that we usually allocate only once. */
+        if (content_length + reply_length + reply->bytes_after + 1 > content_size) {
+            size_t new_size = content_length + reply_length + reply->bytes_after + 1;
+            char *new_content = realloc(content, new_size);
+            if (new_content == NULL)
+                goto fail;
+
+            content = new_content;
+            content_size = new_size;
+        }
+
+        memcpy(content + content_length, xcb_get_property_value(reply), reply_length);
+        content_length += reply_length;
+
+        if (reply->bytes_after == 0)
+            break;
+
+        /* The property is larger than what we asked for, so continue where
+         * this reply ended and request exactly the remainder. Offsets are in
+         * 32-bit units, which the length of a truncated reply always is a
+         * multiple of. */
+        if (content_length % 4 != 0)
+            goto fail;
 
-    if (asprintf(&content, "%.*s", reply_length, (char *)xcb_get_property_value(reply)) < 0) {
+        cookie = xcb_get_property(conn, 0, window, atom, type, content_length / 4,
+                (reply->bytes_after + 3) / 4);
         FREE(reply);
-        return NULL;
     }
 
     FREE(reply);
+    content[content_length] = '\0';
     return content;
+
+fail:
+    FREE(err);
+    FREE(reply);
+    FREE(content);
+    return NULL;
+}
+
+char *xcb_util_get_property(xcb_connection_t *conn, xcb_window_t window, xcb_atom_t atom,
+        xcb_atom_t type, size_t size) {
+    xcb_get_property_cookie_t cookie = xcb_util_get_property_request(conn, window, atom, type, size);
+    return xcb_util_get_property_reply(conn, cookie, window, atom, type);
 }
@@ -27,6 +27,11 @@
 #include <stdbool.h>
 #include <stdarg.h>
 #include <string.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include <X11/Xlib-xcb.h>
 #include <X11/Xresource.h>
@@ -43,6 +48,15 @@
 
 #define SKIP 77
 
+#define CONCURRENCY_READERS 4
+#define CONCURRENCY_UPDATES 200
+
+typedef struct concurrency_state_t {
+    xcb_xrm_database_t *database;
+    bool done;
+    bool err;
+} concurrency_state_t;
+
 static Display *display;
 static xcb_connection_t *conn;
 static xcb_screen_t *screen;
@@ -58,6 +72,21 @@ static int test_get_resource(void);
 static int test_put_resource(void);
 static int test_combine_databases(void);
 static int test_convert(void);
+static int test_quarks(void);
+static int test_cache(void);
+static int test_batch(void);
+static int test_search_list(void);
+static int test_freeze(void);
+static int test_concurrency(void);
+static int test_update(void);
+static int test_from_file(void);
+static int test_serialize(void);
+static int test_write(void);
+static int test_parallel(void);
+static int test_include(void);
+static int test_stats(void);
+static int test_lazy(void);
+static int test_shared(void);
 
 /* Assertion utilities */
 static bool check_strings(const char *expected, const char *actual,
@@ -76,6 +105,17 @@ static int check_get_resource(const char *database, const char *res_name, const
 static int check_database(xcb_xrm_database_t *database, const char *expected);
 static int check_convert_to_long(const char *value, const long expected);
 static int check_convert_to_bool(const char *value, const bool expected);
+static int check_get_resource_q(const char *str_database, const char *res_name, const char *res_class,
+        const char *value);
+static void *concurrency_reader(void *data);
+static int write_collect(void *data, const char *buffer, size_t length);
+static int write_fail(void *data, const char *buffer, size_t length);
+static bool write_file(const char *filename, const char *format, ...) ATTRIBUTE_PRINTF(2, 3);
+static void trace_lookup(void *data, const char *name, const char *class, uint64_t duration);
+static void set_resource_manager(const char *resources, int length);
+static int compare_names(const void *first, const void *second);
+static char *list_snapshots(bool current, int *count);
+static void unlink_snapshots(const char *keep);
 
 int main(void) {
     bool err = false;
@@ -86,6 +126,21 @@ int main(void) {
     err |= test_put_resource();
     err |= test_combine_databases();
     err |= test_convert();
+    err |= test_quarks();
+    err |= test_cache();
+    err |= test_batch();
+    err |= test_search_list();
+    err |= test_freeze();
+    err |= test_concurrency();
+    err |= test_update();
+    err |= test_from_file();
+    err |= test_serialize();
+    err |= test_write();
+    err |= test_parallel();
+    err |= test_include();
+    err |= test_stats();
+    err |= test_lazy();
+    err |= test_shared();
     cleanup();
 
     return err;
@@ -93,6 +148,8 @@ int main(void) {
 
 static int test_entry_parser(void) {
     bool err = false;
+    char long_value[8192];
+    char long_entry[8200];
 
     check_parse_entry_resource_only = false;
 
@@ -134,6 +191,13 @@ static int test_entry_parser(void) {
     err |= check_parse_entry("First: x\\nx", "x\nx", ".", 1, "First");
     err |= check_parse_entry("First: \\080", "\\080", ".", 1, "First");
     err |= check_parse_entry("First: \\00a", "\\00a", ".", 1, "First");
+    /* Long values */
+    memset(long_value, 'x', sizeof(long_value) - 1);
+    long_value[sizeof(long_value) - 1] = '\0';
+    snprintf(long_entry, sizeof(long_entry), "First: %s", long_value);
+    err |= check_parse_entry(long_entry, long_value, ".", 1, "First");
+    err |= check_parse_entry("First: 0123456789abcdef0123\\n456789abcdef\\ ",
+            "0123456789abcdef0123\n456789abcdef ", ".", 1, "First");
 
     /* Invalid entries */
     err |= check_parse_entry_error(": 1", -1);
@@ -158,6 +222,8 @@ static int test_entry_parser(void) {
 
 static int test_get_resource(void) {
     bool err = false;
+    char str_database[2048];
+    char *outwalk;
 
     /* Non-matches / Errors */
     err |= check_get_resource("", "", "", NULL, false);
@@ -204,6 +270,8 @@ static int test_get_resource(void) {
     err |= check_get_resource("First.second.third: 1", "First.third.third", "first.second.fourth", "1", false);
     err |= check_get_resource("First*third*fifth: 1", "First.second.third.fourth.third.fifth", "", "1", false);
     err |= check_get_resource("First: x\\\ny", "First", "", "xy", false);
+    err |= check_get_resource("First: 0123456789abcdef0123\\\n456789abcdef\nSecond: 1", "First", "",
+            "0123456789abcdef0123456789abcdef", false);
     err |= check_get_resource("! First: x", "First", "", NULL, false);
     err |= check_get_resource("# First: x", "First", "", NULL, false);
     /* Matching among multiple entries */
@@ -291,6 +359,22 @@ static int test_get_resource(void) {
     err |= check_get_resource("rofi.normal: #000000, #000000, #000000, #000000", "rofi.normal", "",
             "#000000, #000000, #000000, #000000", false);
 
+    /* Lookups with more candidates or components than the matcher keeps on
+     * the stack. Every entry matches, but only the last one matches all names. */
+    outwalk = str_database;
+    for (int i = 0; i < 81; i++) {
+        for (int j = 0, digits = i; j < 4; j++, digits /= 3) {
+            const char *components[] = { "?", "ABCD" + j, "abcd" + j };
+            outwalk += sprintf(outwalk, "%s%.1s", j == 0 ? "" : ".", components[digits % 3]);
+        }
+        outwalk += sprintf(outwalk, ": %d\n", i);
+    }
+    err |= check_get_resource(str_database, "a.b.c.d", "A.B.C.D", "80", false);
+    err |= check_get_resource(
+            "*c19: 1\n"
+            "c0*c19: 2\n",
+            "c0.c1.c2.c3.c4.c5.c6.c7.c8.c9.c10.c11.c12.c13.c14.c15.c16.c17.c18.c19", "", "2", false);
+
     return err;
 }
 
@@ -371,11 +455,57 @@ static int test_combine_databases(void) {
             "a3: 3\n");
     xcb_xrm_database_free(target_db);
 
+    /* The same, but with a source database which is larger than the target
+     * database. */
+    source_db = xcb_xrm_database_from_string(
+            "a1.b1*c1: 1\n"
+            "a2.b2: 2\n"
+            "a3: 3\n"
+            "a5: 5\n");
+    target_db = xcb_xrm_database_from_string(
+            "a3: 0\n"
+            "a1.b1*c1: 0\n"
+            "a4.?.b4: 0\n");
+    xcb_xrm_database_combine(source_db, &target_db, false);
+    err |= check_database(target_db,
+            "a3: 0\n"
+            "a1.b1*c1: 0\n"
+            "a4.?.b4: 0\n"
+            "a2.b2: 2\n"
+            "a5: 5\n");
+    xcb_xrm_database_put_resource(&target_db, "a3", "6");
+    err |= check_database(target_db,
+            "a1.b1*c1: 0\n"
+            "a4.?.b4: 0\n"
+            "a2.b2: 2\n"
+            "a5: 5\n"
+            "a3: 6\n");
+    xcb_xrm_database_free(target_db);
+
+    source_db = xcb_xrm_database_from_string(
+            "a1.b1*c1: 1\n"
+            "a2.b2: 2\n"
+            "a3: 3\n"
+            "a5: 5\n");
+    target_db = xcb_xrm_database_from_string(
+            "a3: 0\n"
+            "a1.b1*c1: 0\n"
+            "a4.?.b4: 0\n");
+    xcb_xrm_database_combine(source_db, &target_db, true);
+    err |= check_database(target_db,
+            "a4.?.b4: 0\n"
+            "a1.b1*c1: 1\n"
+            "a2.b2: 2\n"
+            "a3: 3\n"
+            "a5: 5\n");
+    xcb_xrm_database_free(target_db);
+
     return err;
 }
 
 static int test_convert(void) {
     bool err = false;
+    xcb_xrm_database_t *database;
 
     err |= check_convert_to_bool(NULL, false);
     err |= check_convert_to_bool("", false);
@@ -403,6 +533,780 @@ static int test_convert(void) {
     err |= check_convert_to_long("-1", -1);
     err |= check_convert_to_long("100", 100);
 
+    /* Converted values are cached on the matched entry. */
+    database = xcb_xrm_database_from_string("First: 42\nSecond: on\n");
+    for (int i = 0; i < 2; i++) {
+        err |= check_longs(42, xcb_xrm_resource_get_long(database, "First", NULL),
+                "Expected 42 for <First>\n");
+        err |= check_ints(true, xcb_xrm_resource_get_bool(database, "First", NULL),
+                "Expected true for <First>\n");
+        err |= check_longs(LONG_MIN, xcb_xrm_resource_get_long(database, "Second", NULL),
+                "Expected LONG_MIN for <Second>\n");
+        err |= check_ints(true, xcb_xrm_resource_get_bool(database, "Second", NULL),
+                "Expected true for <Second>\n");
+    }
+
+    xcb_xrm_database_put_resource(&database, "First", "0");
+    err |= check_longs(0, xcb_xrm_resource_get_long(database, "First", NULL),
+            "Expected 0 for the replaced <First>\n");
+    err |= check_ints(false, xcb_xrm_resource_get_bool(database, "First", NULL),
+            "Expected false for the replaced <First>\n");
+    xcb_xrm_database_free(database);
+
+    return err;
+}
+
+static int test_quarks(void) {
+    bool err = false;
+    xcb_xrm_quark_t quarks[3];
+
+    err |= check_ints(true, xcb_xrm_string_to_quark("First") == xcb_xrm_string_to_quark("First"),
+            "Expected equal strings to map to the same quark\n");
+    err |= check_ints(false, xcb_xrm_string_to_quark("First") == xcb_xrm_string_to_quark("first"),
+            "Expected different strings to map to different quarks\n");
+    err |= check_strings("First", xcb_xrm_quark_to_string(xcb_xrm_string_to_quark("First")),
+            "Expected <First>, but got <%s>\n", xcb_xrm_quark_to_string(xcb_xrm_string_to_quark("First")));
+    err |= check_strings(NULL, xcb_xrm_quark_to_string(XCB_XRM_NULLQUARK),
+            "Expected no string for XCB_XRM_NULLQUARK\n");
+
+    err |= check_ints(2, xcb_xrm_string_to_quark_list("First.second", quarks, 3),
+            "Expected two components\n");
+    err |= check_ints(true, quarks[1] == xcb_xrm_string_to_quark("second") && quarks[2] == XCB_XRM_NULLQUARK,
+            "Wrong quark list for <First.second>\n");
+    err |= check_ints(-1, xcb_xrm_string_to_quark_list("First.second.third", quarks, 3),
+            "Expected an error for a too small quark list\n");
+    err |= check_ints(-1, xcb_xrm_string_to_quark_list("First*second", quarks, 3),
+            "Expected an error for a loose binding\n");
+
+    err |= check_get_resource_q("First: 1", "First", "", "1");
+    err |= check_get_resource_q("First: 1", "Second", "First", "1");
+    err |= check_get_resource_q("First.second: 1", "First", "", NULL);
+    err |= check_get_resource_q("First.second: 1", "First.second", "First", NULL);
+    err |= check_get_resource_q(
+            "xmh*Paned*activeForeground: red\n"
+            "*incorporate.Foreground: blue\n"
+            "xmh.toc*Command*activeForeground: green\n"
+            "xmh.toc*?.Foreground: white\n"
+            "xmh.toc*Command.activeForeground: black",
+            "xmh.toc.messagefunctions.incorporate.activeForeground",
+            "Xmh.Paned.Box.Command.Foreground",
+            "black");
+
+    return err;
+}
+
+static int test_cache(void) {
+    bool err = false;
+    xcb_xrm_database_t *database;
+    xcb_xrm_database_t *source;
+    unsigned long hits;
+    unsigned long misses;
+    char *value;
+
+    database = xcb_xrm_database_from_string(
+            "First*third: 1\n"
+            "First.second: 2\n");
+    err |= check_ints(0, xcb_xrm_database_set_cache_size(database, 16), "Failed to enable the cache\n");
+
+    value = xcb_xrm_resource_get_string(database, "First.second", NULL);
+    err |= check_strings("2", value, "Expected <2>, but got <%s>\n", value);
+    FREE(value);
+    value = xcb_xrm_resource_get_string(database, "First.second", "");
+    err |= check_strings("2", value, "Expected <2>, but got <%s>\n", value);
+    FREE(value);
+    err |= check_longs(1, xcb_xrm_resource_get_long(database, "x.third", "First.third"),
+            "Expected <1> for x.third\n");
+    err |= check_longs(1, xcb_xrm_resource_get_long(database, "x.third", "First.third"),
+            "Expected <1> for x.third\n");
+    err |= check_ints(false, xcb_xrm_resource_get_bool(database, "First.fourth", NULL),
+            "Expected no match for First.fourth\n");
+    err |= check_ints(false, xcb_xrm_resource_get_bool(database, "First.fourth", NULL),
+            "Expected no match for First.fourth\n");
+
+    xcb_xrm_database_get_cache_stats(database, &hits, &misses);
+    err |= check_longs(3, hits, "Expected <3> cache hits, but found <%lu>\n", hits);
+    err |= check_longs(3, misses, "Expected <3> cache misses, but found <%lu>\n", misses);
+
+    /* Modifications must invalidate cached results. */
+    xcb_xrm_database_put_resource(&database, "First.second", "3");
+    value = xcb_xrm_resource_get_string(database, "First.second", NULL);
+    err |= check_strings("3", value, "Expected <3>, but got <%s>\n", value);
+    FREE(value);
+
+    xcb_xrm_database_put_resource_line(&database, "First.fourth: on");
+    err |= check_ints(true, xcb_xrm_resource_get_bool(database, "First.fourth", NULL),
+            "Expected <true> for First.fourth\n");
+
+    source = xcb_xrm_database_from_string("First.second: 4\n");
+    xcb_xrm_database_combine(source, &database, true);
+    value = xcb_xrm_resource_get_string(database, "First.second", NULL);
+    err |= check_strings("4", value, "Expected <4>, but got <%s>\n", value);
+    FREE(value);
+
+    xcb_xrm_database_free(database);
+    return err;
+}
+
+static int test_batch(void) {
+    bool err = false;
+    xcb_xrm_database_t *database;
+    const char *leaf_names[] = { "incorporate.activeForeground", "incorporate.font", "background", "geometry" };
+    const char *leaf_classes[] = { "Command.Foreground", "Command.Font", "Background", "Geometry" };
+    const char *expected[] = { "black", "fixed", "gray", NULL };
+    const char *expected_no_class[] = { NULL, "fixed", "gray", NULL };
+    const char *values[4];
+
+    database = xcb_xrm_database_from_string(
+            "xmh*Paned*activeForeground: red\n"
+            "*incorporate.Foreground: blue\n"
+            "xmh.toc*Command*activeForeground: green\n"
+            "xmh.toc*?.Foreground: white\n"
+            "xmh.toc*Command.activeForeground: black\n"
+            "xmh*font: fixed\n"
+            "*toc*background: gray\n");
+
+    err |= check_ints(3, xcb_xrm_resource_get_batch(database, "xmh.toc.messagefunctions", "Xmh.Paned.Box",
+                leaf_names, leaf_classes, 4, values), "Expected three resources to be found\n");
+    for (int i = 0; i < 4; i++) {
+        err |= check_strings(expected[i], values[i], "Expected <%s>, but got <%s>\n", expected[i], values[i]);
+    }
+
+    err |= check_ints(2, xcb_xrm_resource_get_batch(database, "xmh.toc.messagefunctions", NULL,
+                leaf_names, NULL, 4, values), "Expected two resources to be found\n");
+    for (int i = 0; i < 4; i++) {
+        err |= check_strings(expected_no_class[i], values[i], "Expected <%s>, but got <%s>\n",
+                expected_no_class[i], values[i]);
+    }
+
+    /* Without a prefix, the leaves are looked up on their own. */
+    err |= check_ints(1, xcb_xrm_resource_get_batch(database, NULL, NULL, (const char *[]) { "toc.background" },
+                NULL, 1, values), "Expected one resource to be found\n");
+    err |= check_strings("gray", values[0], "Expected <gray>, but got <%s>\n", values[0]);
+
+    err |= check_ints(-1, xcb_xrm_resource_get_batch(database, "xmh.toc", "Xmh",
+                leaf_names, leaf_classes, 4, values), "Expected an error for a mismatching prefix class\n");
+
+    xcb_xrm_database_free(database);
+    return err;
+}
+
+static int test_search_list(void) {
+    bool err = false;
+    xcb_xrm_database_t *database;
+    xcb_xrm_search_list_t *list;
+    const char *value;
+
+    database = xcb_xrm_database_from_string(
+            "xmh*Paned*activeForeground: red\n"
+            "*incorporate.Foreground: blue\n"
+            "xmh.toc*Command*activeForeground: green\n"
+            "xmh.toc*?.Foreground: white\n"
+            "xmh.toc*Command.activeForeground: black\n"
+            "*Box*background: gray\n");
+
+    list = xcb_xrm_database_get_search_list(database, "xmh.toc.messagefunctions", "Xmh.Paned.Box");
+    value = xcb_xrm_search_list_get_resource(list, "incorporate.activeForeground", "Command.Foreground");
+    err |= check_strings("black", value, "Expected <black>, but got <%s>\n", value);
+    value = xcb_xrm_search_list_get_resource(list, "incorporate.foreground", "Command.Foreground");
+    err |= check_strings("blue", value, "Expected <blue>, but got <%s>\n", value);
+    value = xcb_xrm_search_list_get_resource(list, "background", "Background");
+    err |= check_strings("gray", value, "Expected <gray>, but got <%s>\n", value);
+    /* The prefix's class must not be used for queries without a class. */
+    value = xcb_xrm_search_list_get_resource(list, "background", NULL);
+    err |= check_strings(NULL, value, "Expected no match, but got <%s>\n", value);
+    value = xcb_xrm_search_list_get_resource(list, "background", "Background.Color");
+    err |= check_strings(NULL, value, "Expected no match, but got <%s>\n", value);
+    xcb_xrm_search_list_free(list);
+
+    list = xcb_xrm_database_get_search_list(database, "xmh.toc.messagefunctions", NULL);
+    value = xcb_xrm_search_list_get_resource(list, "incorporate.Foreground", "");
+    err |= check_strings("blue", value, "Expected <blue>, but got <%s>\n", value);
+    value = xcb_xrm_search_list_get_resource(list, "background", "Background");
+    err |= check_strings(NULL, value, "Expected no match, but got <%s>\n", value);
+    xcb_xrm_search_list_free(list);
+
+    list = xcb_xrm_database_get_search_list(database, "xmh.toc", "Xmh");
+    err |= check_ints(true, list == NULL, "Expected an error for a mismatching class\n");
+
+    xcb_xrm_database_free(database);
+    return err;
+}
+
+static int test_freeze(void) {
+    bool err = false;
+    xcb_xrm_database_t *database;
+    char *value;
+
+    database = xcb_xrm_database_from_string(
+            "xmh*Paned*activeForeground: red\n"
+            "*incorporate.Foreground: blue\n"
+            "xmh.toc*Command*activeForeground: green\n"
+            "xmh.toc*?.Foreground: white\n"
+            "xmh.toc*Command.activeForeground: black\n");
+    err |= check_ints(0, xcb_xrm_database_freeze(database), "Failed to freeze the database\n");
+
+    value = xcb_xrm_resource_get_string(database, "xmh.toc.messagefunctions.incorporate.activeForeground",
+            "Xmh.Paned.Box.Command.Foreground");
+    err |= check_strings("black", value, "Expected <black>, but got <%s>\n", value);
+    FREE(value);
+    value = xcb_xrm_resource_get_string(database, "xmh.toc.messagefunctions.incorporate.foreground", NULL);
+    err |= check_strings(NULL, value, "Expected no match, but got <%s>\n", value);
+    FREE(value);
+
+    /* Modifying the database discards the frozen index. */
+    xcb_xrm_database_put_resource(&database, "xmh.toc.messagefunctions.incorporate.activeForeground", "yellow");
+    value = xcb_xrm_resource_get_string(database, "xmh.toc.messagefunctions.incorporate.activeForeground",
+            "Xmh.Paned.Box.Command.Foreground");
+    err |= check_strings("yellow", value, "Expected <yellow>, but got <%s>\n", value);
+    FREE(value);
+
+    err |= check_ints(0, xcb_xrm_database_freeze(database), "Failed to freeze the database\n");
+    value = xcb_xrm_resource_get_string(database, "xmh.toc.messagefunctions.incorporate.activeForeground",
+            "Xmh.Paned.Box.Command.Foreground");
+    err |= check_strings("yellow", value, "Expected <yellow>, but got <%s>\n", value);
+    FREE(value);
+
+    xcb_xrm_database_free(database);
+    return err;
+}
+
+static int test_concurrency(void) {
+    bool err = false;
+    pthread_t readers[CONCURRENCY_READERS];
+    concurrency_state_t state = { .done = false, .err = false };
+    char value[16];
+    char *actual;
+
+    state.database = xcb_xrm_database_from_string(
+            "First.second: 0\n"
+            "*third: 1\n");
+    err |= check_ints(0, xcb_xrm_database_enable_concurrency(state.database),
+            "Failed to enable concurrency\n");
+
+    for (int i = 0; i < CONCURRENCY_READERS; i++)
+        pthread_create(&readers[i], NULL, concurrency_reader, &state);
+
+    for (int i = 1; i <= CONCURRENCY_UPDATES; i++) {
+        snprintf(value, sizeof(value), "%d", i);
+        xcb_xrm_database_put_resource(&(state.database), "First.second", value);
+
+        if (i % 10 == 0) {
+            xcb_xrm_database_t *source = xcb_xrm_database_from_string(
+                    "First.fourth: 4\n"
+                    "*?.fifth: 5\n");
+            xcb_xrm_database_combine(source, &(state.database), true);
+        }
+    }
+
+    __atomic_store_n(&(state.done), true, __ATOMIC_SEQ_CST);
+    for (int i = 0; i < CONCURRENCY_READERS; i++)
+        pthread_join(readers[i], NULL);
+
+    err |= check_ints(false, state.err, "Lookups returned an unexpected result\n");
+    actual = xcb_xrm_resource_get_string(state.database, "First.second", NULL);
+    err |= check_strings("200", actual, "Expected <200>, but got <%s>\n", actual);
+    FREE(actual);
+    err |= check_longs(5, xcb_xrm_resource_get_long(state.database, "First.fifth", NULL),
+            "Expected <5> for First.fifth\n");
+
+    xcb_xrm_database_free(state.database);
+    return err;
+}
+
+static int test_update(void) {
+    bool err = false;
+    xcb_xrm_database_t *database;
+    xcb_xrm_database_t *source;
+    char **changed_keys;
+    char *value;
+    xcb_xrm_database_stats_t stats;
+    size_t storage_size = 0;
+
+    database = xcb_xrm_database_from_string(
+            "a1.b1*c1: 1\n"
+            "a2.b2: 2\n"
+            "*a3: 3\n");
+    source = xcb_xrm_database_from_string(
+            "*a3: 3\n"
+            "a1.b1*c1: 0\n"
+            "a4.?.b4: 4\n");
+
+    err |= check_ints(3, xcb_xrm_database_update(database, source, &changed_keys),
+            "Expected three changed specifiers\n");
+    err |= check_strings("a2.b2", changed_keys[0], "Expected <a2.b2>, but got <%s>\n", changed_keys[0]);
+    err |= check_strings("a1.b1*c1", changed_keys[1], "Expected <a1.b1*c1>, but got <%s>\n", changed_keys[1]);
+    err |= check_strings("a4.?.b4", changed_keys[2], "Expected <a4.?.b4>, but got <%s>\n", changed_keys[2]);
+    err |= check_strings(NULL, changed_keys[3], "Expected the list to end, but got <%s>\n", changed_keys[3]);
+    for (int i = 0; changed_keys[i] != NULL; i++)
+        FREE(changed_keys[i]);
+    FREE(changed_keys);
+
+    err |= check_database(database,
+            "*a3: 3\n"
+            "a1.b1*c1: 0\n"
+            "a4.?.b4: 4\n");
+    value = xcb_xrm_resource_get_string(database, "a2.b2", NULL);
+    err |= check_strings(NULL, value, "Expected no match, but got <%s>\n", value);
+    FREE(value);
+
+    /* Updating again does not change anything. */
+    err |= check_ints(0, xcb_xrm_database_update(database, source, &changed_keys),
+            "Expected no changed specifiers\n");
+    err |= check_ints(true, changed_keys == NULL, "Expected no list of changed specifiers\n");
+    xcb_xrm_database_free(source);
+
+    /* Changing a value over and over again does not keep allocating. */
+    for (int i = 0; i < 1000; i++) {
+        char resources[64];
+
+        snprintf(resources, sizeof(resources), "*a3: 3\na1.b1*c1: %d\n", i);
+        source = xcb_xrm_database_from_string(resources);
+        xcb_xrm_database_update(database, source, NULL);
+        xcb_xrm_database_free(source);
+
+        xcb_xrm_database_get_stats(database, &stats);
+        if (i == 0)
+            storage_size = stats.storage_size;
+    }
+    err |= check_ints(true, stats.storage_size <= 2 * storage_size,
+            "Expected at most %zu bytes of storage, but got %zu\n", 2 * storage_size, stats.storage_size);
+    value = xcb_xrm_resource_get_string(database, "a1.b1.c1", NULL);
+    err |= check_strings("999", value, "Expected <999>, but got <%s>\n", value);
+    FREE(value);
+
+    /* Nothing is left of the removed entries' nodes. */
+    source = xcb_xrm_database_from_string("");
+    xcb_xrm_database_update(database, source, NULL);
+    err |= check_ints(true, database->root->tight.count == 0 && database->root->loose.count == 0 &&
+            database->root->tight_wildcard == NULL && database->root->loose_wildcard == NULL,
+            "Expected the index to be empty\n");
+    xcb_xrm_database_free(source);
+
+    xcb_xrm_database_free(database);
+    return err;
+}
+
+static int test_from_file(void) {
+    bool err = false;
+    xcb_xrm_database_t *database;
+    char filename[] = "/tmp/xcb-util-xrm-test-XXXXXX";
+    /* The last line neither ends in a newline nor completes its continuation. */
+    const char *content =
+        "First: 1\n"
+        "Second: 2\\\n"
+        "2\n"
+        "Third: 3\\";
+    int fd;
+
+    if ((fd = mkstemp(filename)) < 0) {
+        fprintf(stderr, "Failed to create a temporary file\n");
+        return true;
+    }
+    if (write(fd, content, strlen(content)) != (ssize_t)strlen(content)) {
+        fprintf(stderr, "Failed to write a temporary file\n");
+        close(fd);
+        unlink(filename);
+        return true;
+    }
+    close(fd);
+
+    database = xcb_xrm_database_from_file(filename);
+    err |= check_database(database,
+            "First: 1\n"
+            "Second: 22\n"
+            "Third: 3\\\\\n");
+    xcb_xrm_database_free(database);
+
+    /* Empty files are read instead of mapped. */
+    if (truncate(filename, 0) == 0) {
+        database = xcb_xrm_database_from_file(filename);
+        err |= check_ints(true, database != NULL, "Expected an empty database\n");
+        xcb_xrm_database_free(database);
+    }
+
+    unlink(filename);
+
+    database = xcb_xrm_database_from_file("/nonexistent/xcb-util-xrm");
+    err |= check_ints(true, database == NULL, "Expected no database for a missing file\n");
+
+    return err;
+}
+
+static int test_serialize(void) {
+    bool err = false;
+    xcb_xrm_database_t *database;
+    xcb_xrm_database_t *loaded;
+    void *blob;
+    size_t length;
+    char *value;
+
+    database = xcb_xrm_database_from_string(
+            "First.second: 1\n"
+            "First*?.fourth: 2\n"
+            "*third: x\\ y\\nz\n"
+            "First.second: 3\n");
+
+    err |= check_ints(0, xcb_xrm_database_serialize(database, &blob, &length), "Expected the database to be serialized\n");
+    loaded = xcb_xrm_database_from_blob(blob, length);
+    err |= check_database(loaded,
+            "First*?.fourth: 2\n"
+            "*third: x y\\nz\n"
+            "First.second: 3\n");
+
+    value = xcb_xrm_resource_get_string(loaded, "First.x.fourth", NULL);
+    err |= check_strings("2", value, "Expected <2>, but got <%s>\n", value);
+    FREE(value);
+    value = xcb_xrm_resource_get_string(loaded, "third", NULL);
+    err |= check_strings("x y\nz", value, "Expected <x y\\nz>, but got <%s>\n", value);
+    FREE(value);
+    xcb_xrm_database_free(loaded);
+
+    /* Truncated or otherwise corrupted blobs are rejected. */
+    loaded = xcb_xrm_database_from_blob(blob, length - 1);
+    err |= check_ints(true, loaded == NULL, "Expected a truncated blob to be rejected\n");
+    ((unsigned char *)blob)[0] ^= 0xff;
+    loaded = xcb_xrm_database_from_blob(blob, length);
+    err |= check_ints(true, loaded == NULL, "Expected a blob with a bad magic number to be rejected\n");
+    FREE(blob);
+    xcb_xrm_database_free(database);
+
+    /* An empty database can be serialized, too. */
+    database = xcb_xrm_database_from_string("");
+    err |= check_ints(0, xcb_xrm_database_serialize(database, &blob, &length), "Expected the database to be serialized\n");
+    loaded = xcb_xrm_database_from_blob(blob, length);
+    err |= check_ints(true, loaded != NULL, "Expected an empty database\n");
+    FREE(blob);
+    xcb_xrm_database_free(loaded);
+    xcb_xrm_database_free(database);
+
+    return err;
+}
+
+static int test_write(void) {
+    bool err = false;
+    xcb_xrm_database_t *database = NULL;
+    char *large_value;
+    char *expected;
+    char *str;
+    FILE *stream;
+    size_t size;
+
+    /* Make sure that entries exceed the size of a chunk, both in sum and on
+     * their own. */
+    large_value = calloc(1, 10000 + 1);
+    memset(large_value, 'x', 10000);
+    for (int i = 0; i < 1000; i++) {
+        char resource[32];
+        snprintf(resource, sizeof(resource), "First.Second%d", i);
+        xcb_xrm_database_put_resource(&database, resource, i == 500 ? large_value : " \\value\n");
+    }
+
+    stream = open_memstream(&str, &size);
+    err |= check_ints(0, xcb_xrm_database_write(database, write_collect, stream), "Expected the database to be written\n");
+    fclose(stream);
+
+    expected = xcb_xrm_database_to_string(database);
+    err |= check_strings(expected, str, "Expected the written database to match its string representation\n");
+    err |= check_ints(true, strstr(str, "First.Second999: \\ \\\\value\\n\n") != NULL,
+            "Expected values to be escaped\n");
+    FREE(expected);
+    FREE(str);
+
+    err |= check_ints(-1, xcb_xrm_database_write(database, write_fail, NULL), "Expected the writer to fail\n");
+
+    FREE(large_value);
+    xcb_xrm_database_free(database);
+    return err;
+}
+
+static int test_parallel(void) {
+    bool err = false;
+    xcb_xrm_database_t *database;
+    char filename[] = "/tmp/xcb-util-xrm-test-XXXXXX";
+    const char *included = "Included: 1\nFirst.Second1: included\n";
+    char *str = NULL;
+    size_t size = 0;
+    FILE *stream;
+    char *expected;
+    char *actual;
+    int fd;
+
+    if ((fd = mkstemp(filename)) < 0 || write(fd, included, strlen(included)) != (ssize_t)strlen(included)) {
+        fprintf(stderr, "Failed to create a temporary file\n");
+        return true;
+    }
+    close(fd);
+
+    /* Generate enough input to be split into several parts, with later
+     * definitions overriding earlier ones across the parts. */
+    stream = open_memstream(&str, &size);
+    for (int i = 0; i < 50000; i++) {
+        fprintf(stream, "First.Second%d: %d\n", i % 1000, i);
+        if (i % 997 == 0)
+            fprintf(stream, "First*Third%d: a\\\nb\n", i);
+        if (i == 20000)
+            fprintf(stream, "#include \"%s\"\n", filename);
+    }
+    fclose(stream);
+
+    database = xcb_xrm_database_from_string(str);
+    expected = xcb_xrm_database_to_string(database);
+    xcb_xrm_database_free(database);
+
+    database = xcb_xrm_database_from_string_parallel(str, 4);
+    actual = xcb_xrm_database_to_string(database);
+    err |= check_strings(expected, actual, "Expected the database to match the one parsed on a single thread\n");
+    err |= check_ints(true, strstr(actual, "Included: 1\n") != NULL, "Expected the included file to be parsed\n");
+    xcb_xrm_database_free(database);
+
+    FREE(actual);
+    FREE(expected);
+    FREE(str);
+    unlink(filename);
+    return err;
+}
+
+static int test_include(void) {
+    bool err = false;
+    xcb_xrm_database_t *database;
+    char directory[] = "/tmp/xcb-util-xrm-test-XXXXXX";
+    char first[64];
+    char second[64];
+    char colors[64];
+    char *str;
+
+    if (mkdtemp(directory) == NULL) {
+        fprintf(stderr, "Failed to create a temporary directory\n");
+        return true;
+    }
+
+    snprintf(first, sizeof(first), "%s/first", directory);
+    snprintf(second, sizeof(second), "%s/second", directory);
+    snprintf(colors, sizeof(colors), "%s/colors", directory);
+
+    /* Both files include the colors and each other. */
+    err |= write_file(first,
+            "First: 1\n"
+            "#include \"%s\"\n"
+            "Color: first\n"
+            "#include \"%s\"\n"
+            "#include \"%s\"\n",
+            colors, second, first);
+    err |= write_file(second,
+            "Second: 2\n"
+            "#include \"%s\"\n"
+            "#include \"%s\"\n",
+            first, colors);
+    err |= write_file(colors, "Color: colors\n");
+
+    database = xcb_xrm_database_from_file(first);
+    err |= check_database(database,
+            "First: 1\n"
+            "Second: 2\n"
+            "Color: colors\n");
+    xcb_xrm_database_free(database);
+
+    if (asprintf(&str, "#include \"%s\"\nThird: 3\n", second) >= 0) {
+        database = xcb_xrm_database_from_string(str);
+        err |= check_database(database,
+                "Second: 2\n"
+                "First: 1\n"
+                "Color: colors\n"
+                "Third: 3\n");
+        xcb_xrm_database_free(database);
+        FREE(str);
+    }
+
+    unlink(first);
+    unlink(second);
+    unlink(colors);
+    rmdir(directory);
+    return err;
+}
+
+static int test_stats(void) {
+    bool err = false;
+    xcb_xrm_database_t *database;
+    xcb_xrm_database_stats_t stats;
+    char *traced = NULL;
+    char *value;
+
+    database = xcb_xrm_database_from_string(
+            "First.second: 1\n"
+            "First*third: 2\n"
+            "*third: 3\n"
+            "First.second: 4\n");
+
+    err |= check_ints(0, xcb_xrm_database_get_stats(database, &stats), "Expected statistics\n");
+    err |= check_ints(3, stats.num_entries, "Expected 3 entries, but got %zu\n", stats.num_entries);
+    err |= check_ints(5, stats.num_components, "Expected 5 components, but got %zu\n", stats.num_components);
+    err |= check_ints(1, stats.duplicates, "Expected 1 duplicate, but got %lu\n", stats.duplicates);
+    err |= check_ints(0, stats.lookups, "Expected no lookups, but got %lu\n", stats.lookups);
+    err |= check_ints(true, stats.storage_size > 0, "Expected storage to be used\n");
+
+    value = xcb_xrm_resource_get_string(database, "First.third", NULL);
+    FREE(value);
+    err |= check_ints(0, xcb_xrm_database_get_stats(database, &stats), "Expected statistics\n");
+    err |= check_ints(1, stats.lookups, "Expected 1 lookup, but got %lu\n", stats.lookups);
+    err |= check_ints(2, stats.candidates, "Expected 2 candidates, but got %lu\n", stats.candidates);
+    err |= check_ints(0, stats.match_time, "Expected lookups not to be timed\n");
+
+    /* With a threshold of zero, every lookup is traced. */
+    xcb_xrm_database_set_trace(database, trace_lookup, &traced, 0);
+    value = xcb_xrm_resource_get_string(database, "First.second", "Class.second");
+    FREE(value);
+    err |= check_strings("First.second Class.second", traced, "Expected the lookup to be traced, but got <%s>\n", traced);
+    FREE(traced);
+
+    xcb_xrm_database_set_trace(database, trace_lookup, &traced, UINT64_MAX);
+    value = xcb_xrm_resource_get_string(database, "First.second", NULL);
+    FREE(value);
+    err |= check_strings(NULL, traced, "Expected the lookup not to be traced, but got <%s>\n", traced);
+
+    xcb_xrm_database_free(database);
+    return err;
+}
+
+static int test_lazy(void) {
+    bool err = false;
+    xcb_xrm_database_t *database;
+    xcb_xrm_database_t *source;
+    const char *str =
+        "First.second: 1\n"
+        "*third: 2\n"
+        "First*third: 3\n"
+        "! Second.second: 4\n"
+        "Second.sec\\\nond: 5\n"
+        "  First.second: 6\n"
+        "Third: 7\n"
+        "Second.second: 8\n"
+        "Second.~: 9\n"
+        "?.fourth: 10\n"
+        "First.fourth: 11\n";
+    char *expected;
+    char *actual;
+    char *value;
+
+    database = xcb_xrm_database_from_string(str);
+    expected = xcb_xrm_database_to_string(database);
+    xcb_xrm_database_free(database);
+
+    /* Lines are parsed in groups as queries need them. Earlier lines must
+     * still be overridden by later ones, even if those were parsed first. */
+    database = xcb_xrm_database_from_string_lazy(str);
+    value = xcb_xrm_resource_get_string(database, "First.second", NULL);
+    err |= check_strings("6", value, "Expected <6>, but got <%s>\n", value);
+    FREE(value);
+    value = xcb_xrm_resource_get_string(database, "Other.second", "Second.second");
+    err |= check_strings("8", value, "Expected <8>, but got <%s>\n", value);
+    FREE(value);
+    value = xcb_xrm_resource_get_string(database, "Third", NULL);
+    err |= check_strings("7", value, "Expected <7>, but got <%s>\n", value);
+    FREE(value);
+    value = xcb_xrm_resource_get_string(database, "Other.fourth", NULL);
+    err |= check_strings("10", value, "Expected <10>, but got <%s>\n", value);
+    FREE(value);
+
+    actual = xcb_xrm_database_to_string(database);
+    err |= check_strings(expected, actual, "Expected <%s>, but got <%s>\n", expected, actual);
+    FREE(actual);
+    xcb_xrm_database_free(database);
+
+    /* Inserting an entry parses the lines it might override first. */
+    database = xcb_xrm_database_from_string_lazy(str);
+    xcb_xrm_database_put_resource(&database, "First.fourth", "12");
+    xcb_xrm_database_put_resource(&database, "Third", "13");
+    value = xcb_xrm_resource_get_string(database, "First.fourth", NULL);
+    err |= check_strings("12", value, "Expected <12>, but got <%s>\n", value);
+    FREE(value);
+    err |= check_database(database,
+            "*third: 2\n"
+            "First*third: 3\n"
+            "First.second: 6\n"
+            "Second.second: 8\n"
+            "?.fourth: 10\n"
+            "First.fourth: 12\n"
+            "Third: 13\n");
+    xcb_xrm_database_free(database);
+
+    /* Combining parses the lines of both databases. */
+    database = xcb_xrm_database_from_string_lazy("First.second: 1\nFirst.fifth: 2\n");
+    source = xcb_xrm_database_from_string_lazy("First.fifth: 3\nSecond.fifth: 4\n");
+    xcb_xrm_database_combine(source, &database, false);
+    err |= check_database(database,
+            "First.second: 1\n"
+            "First.fifth: 2\n"
+            "Second.fifth: 4\n");
+    xcb_xrm_database_free(database);
+
+    FREE(expected);
+    return err;
+}
+
+static int test_shared(void) {
+    bool err = false;
+    xcb_xrm_database_t *database;
+    xcb_get_property_reply_t *reply;
+    char resources[64];
+    char *before;
+    char *first;
+    char *second;
+    char *third;
+    int num_before;
+    int num_first;
+    int num_second;
+    int num_third;
+    DIR *dir;
+
+    if ((dir = opendir("/dev/shm")) == NULL) {
+        fprintf(stderr, "Skipping the shared memory test since /dev/shm does not exist\n");
+        return false;
+    }
+    closedir(dir);
+
+    /* The property and the shared memory objects are restored afterwards. */
+    before = list_snapshots(true, &num_before);
+    reply = xcb_get_property_reply(conn, xcb_get_property(conn, false, screen->root,
+                XCB_ATOM_RESOURCE_MANAGER, XCB_ATOM_STRING, 0, UINT32_MAX), NULL);
+
+    /* The resources are unique, so that their snapshots are published by this
+     * test. */
+    snprintf(resources, sizeof(resources), "Shared.first: %d\n", (int) getpid());
+    set_resource_manager(resources, strlen(resources));
+    database = xcb_xrm_database_from_resource_manager_shared(conn, screen);
+    err |= check_database(database, resources);
+    xcb_xrm_database_free(database);
+    first = list_snapshots(false, &num_first);
+
+    /* Publishing the snapshot of new resources removes the previous one. */
+    snprintf(resources, sizeof(resources), "Shared.second: %d\n", (int) getpid());
+    set_resource_manager(resources, strlen(resources));
+    database = xcb_xrm_database_from_resource_manager_shared(conn, screen);
+    err |= check_database(database, resources);
+    xcb_xrm_database_free(database);
+    second = list_snapshots(false, &num_second);
+    err |= check_ints(num_first, num_second, "Expected %d snapshots, but got %d\n", num_first, num_second);
+    err |= check_ints(true, strcmp(first, second) != 0, "Expected the previous snapshot to be replaced\n");
+
+    /* The same resources are loaded from the snapshot. */
+    database = xcb_xrm_database_from_resource_manager_shared(conn, screen);
+    err |= check_database(database, resources);
+    xcb_xrm_database_free(database);
+    third = list_snapshots(false, &num_third);
+    err |= check_strings(second, third, "Expected the snapshots <%s>, but got <%s>\n", second, third);
+
+    if (reply != NULL && reply->type != XCB_NONE)
+        set_resource_manager(xcb_get_property_value(reply), xcb_get_property_value_length(reply));
+    else
+        xcb_delete_property(conn, screen->root, XCB_ATOM_RESOURCE_MANAGER);
+    xcb_flush(conn);
+    unlink_snapshots(before);
+
+    FREE(reply);
+    FREE(before);
+    FREE(first);
+    FREE(second);
+    FREE(third);
     return err;
 }
 
@@ -472,9 +1376,7 @@ static void cleanup(void) {
 
 static int check_parse_entry(const char *str, const char *value, const char *bindings, const int count, ...) {
     xcb_xrm_entry_t *entry;
-    xcb_xrm_component_t *component;
-    int actual_length = 0;
-    int i = 0;
+    int actual_length;
     va_list ap;
 
     fprintf(stderr, "== Assert that parsing \"%s\" is successful\n", str);
@@ -494,14 +1396,13 @@ static int check_parse_entry(const char *str, const char *value, const char *bin
     }
 
     /* Assert the number of components. */
-    TAILQ_FOREACH(component, &(entry->components), components) {
-        actual_length++;
-    }
+    actual_length = xcb_xrm_entry_num_components(entry);
     err |= check_ints(count, actual_length, "Wrong number of components: <%d> / <%d>\n", count, actual_length);
 
     /* Assert the individual components. */
     va_start(ap, count);
-    TAILQ_FOREACH(component, &(entry->components), components) {
+    for (int i = 0; i < actual_length && i < count; i++) {
+        xcb_xrm_component_t *component = &(entry->components[i]);
         const char *curr = va_arg(ap, const char *);
         char tmp[2] = "\0";
 
@@ -517,7 +1418,7 @@ static int check_parse_entry(const char *str, const char *value, const char *bin
                 break;
         }
 
-        tmp[0] = bindings[i++];
+        tmp[0] = bindings[i];
         switch (component->binding_type) {
             case BT_TIGHT:
                 err |= check_strings(tmp, ".", "Expected <%s>, but got <.>\n", tmp);
@@ -572,6 +1473,7 @@ static int check_get_resource(const char *str_database, const char *res_name, co
 
     bool err = false;
     char *xcb_value;
+    const char *borrowed_value;
     char *xlib_value;
 
     fprintf(stderr, "== Assert that getting resource <%s> / <%s> returns <%s>\n",
@@ -579,6 +1481,9 @@ static int check_get_resource(const char *str_database, const char *res_name, co
 
     database = xcb_xrm_database_from_string(str_database);
     xcb_value = xcb_xrm_resource_get_string(database, res_name, res_class);
+    borrowed_value = xcb_xrm_resource_get_string_borrowed(database, res_name, res_class);
+    err |= check_strings(xcb_value, borrowed_value, "Borrowed value <%s> differs from <%s>\n",
+            borrowed_value, xcb_value);
     if (xcb_value == NULL) {
         if (value != NULL) {
             fprintf(stderr, "xcb_xrm_resource_get_string() returned NULL\n");
@@ -622,6 +1527,31 @@ static int check_database(xcb_xrm_database_t *database, const char *expected) {
     return err;
 }
 
+static int check_get_resource_q(const char *str_database, const char *res_name, const char *res_class,
+        const char *value) {
+    xcb_xrm_database_t *database;
+    xcb_xrm_quark_t names[16];
+    xcb_xrm_quark_t classes[16];
+    char *actual;
+    bool err = false;
+
+    fprintf(stderr, "== Assert that getting resource <%s> / <%s> by quarks returns <%s>\n",
+            res_name, res_class, value);
+
+    xcb_xrm_string_to_quark_list(res_name, names, 16);
+    classes[0] = XCB_XRM_NULLQUARK;
+    if (strlen(res_class) > 0)
+        xcb_xrm_string_to_quark_list(res_class, classes, 16);
+
+    database = xcb_xrm_database_from_string(str_database);
+    actual = xcb_xrm_resource_get_string_q(database, names, classes);
+    err |= check_strings(value, actual, "Expected <%s>, but got <%s>\n", value, actual);
+
+    FREE(actual);
+    xcb_xrm_database_free(database);
+    return err;
+}
+
 static int check_convert_to_long(const char *value, const long expected) {
     long actual = xcb_xrm_convert_to_long(value);
     return check_longs(expected, actual, "Expected <%ld>, but found <%ld>\n", expected, actual);
@@ -631,3 +1561,154 @@ static int check_convert_to_bool(const char *value, const bool expected) {
     bool actual = xcb_xrm_convert_to_bool(value);
     return check_ints(expected, actual, "Expected <%d>, but found <%d>\n", expected, actual);
 }
+
+static void *concurrency_reader(void *data) {
+    concurrency_state_t *state = data;
+    const char *leaves[] = { "second", "third" };
+    const char *values[2];
+    long previous = 0;
+    long previous_batch = 0;
+
+    /* The search list is kept while the database is modified. */
+    xcb_xrm_search_list_t *list = xcb_xrm_database_get_search_list(state->database, "First", NULL);
+    if (list == NULL) {
+        __atomic_store_n(&(state->err), true, __ATOMIC_SEQ_CST);
+        return NULL;
+    }
+
+    while (!__atomic_load_n(&(state->done), __ATOMIC_SEQ_CST)) {
+        /* Updates must become visible in order. */
+        long current = xcb_xrm_resource_get_long(state->database, "First.second", NULL);
+        const char *fourth = xcb_xrm_resource_get_string_borrowed(state->database, "First.fourth", NULL);
+        const char *listed = xcb_xrm_search_list_get_resource(list, "fourth", NULL);
+        const char *third = xcb_xrm_search_list_get_resource(list, "third", NULL);
+        int found = xcb_xrm_resource_get_batch(state->database, "First", NULL, leaves, NULL, 2, values);
+        long current_batch = found == 2 ? atol(values[0]) : -1;
+
+        if (current < previous || current > CONCURRENCY_UPDATES ||
+                xcb_xrm_resource_get_long(state->database, "First.third", NULL) != 1 ||
+                (fourth != NULL && strcmp(fourth, "4") != 0) ||
+                (listed != NULL && strcmp(listed, "4") != 0) ||
+                third == NULL || strcmp(third, "1") != 0 ||
+                current_batch < previous_batch || current_batch > CONCURRENCY_UPDATES ||
+                strcmp(values[1], "1") != 0) {
+            __atomic_store_n(&(state->err), true, __ATOMIC_SEQ_CST);
+            break;
+        }
+
+        previous = current;
+        previous_batch = current_batch;
+    }
+
+    xcb_xrm_search_list_free(list);
+    return NULL;
+}
+
+static int write_collect(void *data, const char *buffer, size_t length) {
+    return fwrite(buffer, 1, length, data) == length ? 0 : -1;
+}
+
+static int write_fail(void *data, const char *buffer, size_t length) {
+    return -1;
+}
+
+static bool write_file(const char *filename, const char *format, ...) {
+    va_list args;
+    FILE *file;
+    bool err;
+
+    if ((file = fopen(filename, "w")) == NULL) {
+        fprintf(stderr, "Failed to create <%s>\n", filename);
+        return true;
+    }
+
+    va_start(args, format);
+    err = vfprintf(file, format, args) < 0;
+    va_end(args);
+
+    return fclose(file) != 0 || err;
+}
+
+static void trace_lookup(void *data, const char *name, const char *class, uint64_t duration) {
+    char **traced = data;
+
+    free(*traced);
+    if (asprintf(traced, "%s %s", name, class == NULL ? "(null)" : class) < 0)
+        *traced = NULL;
+}
+
+static void set_resource_manager(const char *resources, int length) {
+    xcb_change_property(conn, XCB_PROP_MODE_REPLACE, screen->root, XCB_ATOM_RESOURCE_MANAGER,
+            XCB_ATOM_STRING, 8, length, resources);
+}
+
+static int compare_names(const void *first, const void *second) {
+    return strcmp(*(char * const *) first, *(char * const *) second);
+}
+
+/* Returns the sorted names of the shared memory snapshots of this user,
+ * separated by newlines. The objects naming the current snapshot of a display
+ * have one hash less in their name and are only included if current is set. */
+static char *list_snapshots(bool current, int *count) {
+    char prefix[32];
+    char *names[256];
+    char *list = NULL;
+    size_t size = 0;
+    struct dirent *dirent;
+    FILE *stream;
+    DIR *dir;
+
+    *count = 0;
+    snprintf(prefix, sizeof(prefix), "xcb-xrm-%u-", (unsigned int) geteuid());
+    if ((dir = opendir("/dev/shm")) != NULL) {
+        while ((dirent = readdir(dir)) != NULL && *count < 256) {
+            if (strncmp(dirent->d_name, prefix, strlen(prefix)) != 0 ||
+                    (!current && strchr(dirent->d_name + strlen(prefix), '-') == NULL))
+                continue;
+
+            names[(*count)++] = strdup(dirent->d_name);
+        }
+        closedir(dir);
+    }
+
+    qsort(names, *count, sizeof(char *), compare_names);
+    stream = open_memstream(&list, &size);
+    for (int i = 0; i < *count; i++) {
+        fprintf(stream, "%s\n", names[i]);
+        FREE(names[i]);
+    }
+    fclose(stream);
+
+    return list;
+}
+
+/* Removes the snapshots and current objects of this user which are not listed
+ * in keep, as returned by list_snapshots. */
+static void unlink_snapshots(const char *keep) {
+    char *list;
+    char *line;
+    char *next;
+    int count;
+
+    list = list_snapshots(true, &count);
+    for (line = list; line != NULL && *line != '\0'; line = next) {
+        char name[NAME_MAX + 2];
+        const char *match;
+
+        next = strchr(line, '\n');
+        *(next++) = '\0';
+
+        /* Only whole lines of keep count as a match. */
+        for (match = strstr(keep, line); match != NULL; match = strstr(match + 1, line)) {
+            if ((match == keep || match[-1] == '\n') && match[strlen(line)] == '\n')
+                break;
+        }
+        if (match != NULL)
+            continue;
+
+        snprintf(name, sizeof(name), "/%s", line);
+        shm_unlink(name);
+    }
+
+    FREE(list);
+}